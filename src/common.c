@@ -81,8 +81,15 @@ notify_pixbuf_from_image_data (GVariant *image_data)
     return pix;
 }
 
-gchar *
-notify_icon_name_from_desktop_id (const gchar *desktop_id)
+/* desktop id -> Icon= of all installed applications. It is built on a
+ * worker thread and swapped in on the main thread, so lookups only ever
+ * see a complete table. */
+static GHashTable      *desktop_icons = NULL;
+static GAppInfoMonitor *desktop_monitor = NULL;
+static GCancellable    *desktop_building = NULL;
+
+static gchar *
+notify_icon_name_from_desktop_file (const gchar *desktop_id)
 {
     gchar *icon = NULL;
     GDesktopAppInfo *dt_info = NULL;
@@ -95,3 +102,470 @@ notify_icon_name_from_desktop_id (const gchar *desktop_id)
 
     return icon;
 }
+
+static void
+notify_desktop_index_build_thread (GTask        *task,
+                                   gpointer      source_object,
+                                   gpointer      task_data,
+                                   GCancellable *cancellable)
+{
+    GHashTable *table;
+    GList *infos, *l;
+
+    table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+    infos = g_app_info_get_all ();
+    for (l = infos; l && !g_cancellable_is_cancelled (cancellable); l = l->next) {
+        const gchar *id;
+        gchar *icon;
+
+        if (!G_IS_DESKTOP_APP_INFO (l->data))
+            continue;
+
+        id = g_app_info_get_id (G_APP_INFO (l->data));
+        icon = g_desktop_app_info_get_string (G_DESKTOP_APP_INFO (l->data),
+                                              G_KEY_FILE_DESKTOP_KEY_ICON);
+        if (id && icon)
+            g_hash_table_insert (table, g_strdup (id), icon);
+        else
+            g_free (icon);
+    }
+    g_list_free_full (infos, g_object_unref);
+
+    g_task_return_pointer (task, table, (GDestroyNotify)g_hash_table_unref);
+}
+
+static void
+notify_desktop_index_build_done (GObject      *source_object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+    GHashTable *table;
+
+    /* a build that was superseded comes back cancelled */
+    table = g_task_propagate_pointer (G_TASK (result), NULL);
+    if (!table)
+        return;
+
+    if (desktop_icons)
+        g_hash_table_unref (desktop_icons);
+    desktop_icons = table;
+
+    if (g_task_get_cancellable (G_TASK (result)) == desktop_building)
+        g_clear_object (&desktop_building);
+}
+
+static void
+notify_desktop_index_rebuild (void)
+{
+    GTask *task;
+
+    if (desktop_building) {
+        g_cancellable_cancel (desktop_building);
+        g_object_unref (desktop_building);
+    }
+    desktop_building = g_cancellable_new ();
+
+    task = g_task_new (NULL, desktop_building, notify_desktop_index_build_done, NULL);
+    g_task_run_in_thread (task, notify_desktop_index_build_thread);
+    g_object_unref (task);
+}
+
+static void
+notify_desktop_index_changed (GAppInfoMonitor *monitor,
+                              gpointer         user_data)
+{
+    /* the monitor does not tell what changed, so the table is built again
+     * in the background; the current one is used meanwhile */
+    notify_desktop_index_rebuild ();
+}
+
+void
+notify_desktop_index_init (void)
+{
+    if (desktop_monitor)
+        return;
+
+    desktop_monitor = g_app_info_monitor_get ();
+    g_signal_connect (desktop_monitor, "changed",
+                      G_CALLBACK (notify_desktop_index_changed), NULL);
+
+    notify_desktop_index_rebuild ();
+}
+
+gchar *
+notify_icon_name_from_desktop_id (const gchar *desktop_id)
+{
+    const gchar *icon;
+    gchar *id;
+
+    /* only until the first build is done */
+    if (!desktop_icons)
+        return notify_icon_name_from_desktop_file (desktop_id);
+
+    icon = g_hash_table_lookup (desktop_icons, desktop_id);
+    if (!icon && !g_str_has_suffix (desktop_id, ".desktop")) {
+        /* the hint is usually given without the suffix */
+        id = g_strconcat (desktop_id, ".desktop", NULL);
+        icon = g_hash_table_lookup (desktop_icons, id);
+        g_free (id);
+    }
+
+    return g_strdup (icon);
+}
+
+/* Cuts text down to max_chars characters. Returns NULL when the text
+ * already fits, so short text is never copied. */
+gchar *
+notify_text_truncate (const gchar *text,
+                      gsize        max_chars)
+{
+    const gchar *p = text;
+    gsize n = 0;
+
+    if (!text)
+        return NULL;
+
+    while (*p && n < max_chars) {
+        p = g_utf8_next_char (p);
+        n++;
+    }
+
+    if (!*p)
+        return NULL;
+
+    return g_strndup (text, p - text);
+}
+
+#define MARKUP_MAX_DEPTH 16
+
+typedef enum
+{
+    MARKUP_TAG_UNKNOWN = 0,
+    MARKUP_TAG_B,
+    MARKUP_TAG_I,
+    MARKUP_TAG_U,
+    MARKUP_TAG_A,
+    MARKUP_TAG_IMG,
+} NotifyMarkupTag;
+
+typedef struct
+{
+    NotifyMarkupTag  tag;
+    const gchar     *emitted;
+} NotifyMarkupOpenTag;
+
+static NotifyMarkupTag
+notify_markup_lookup_tag (const gchar *name,
+                          gsize        len)
+{
+    if (len == 1) {
+        switch (g_ascii_tolower (*name)) {
+            case 'b': return MARKUP_TAG_B;
+            case 'i': return MARKUP_TAG_I;
+            case 'u': return MARKUP_TAG_U;
+            case 'a': return MARKUP_TAG_A;
+        }
+    } else if (len == 3 && g_ascii_strncasecmp (name, "img", 3) == 0) {
+        return MARKUP_TAG_IMG;
+    }
+
+    return MARKUP_TAG_UNKNOWN;
+}
+
+/* p points at '&'. Only entities GMarkup accepts are let through. */
+static gboolean
+notify_markup_is_entity (const gchar  *p,
+                         const gchar **end)
+{
+    const gchar *q = p + 1;
+
+    if (*q == '#') {
+        const gchar *digits;
+        gchar *num_end;
+        guint64 c;
+
+        if (q[1] == 'x' || q[1] == 'X') {
+            digits = q + 2;
+            if (!g_ascii_isxdigit (*digits))
+                return FALSE;
+            c = g_ascii_strtoull (digits, &num_end, 16);
+        } else {
+            digits = q + 1;
+            if (!g_ascii_isdigit (*digits))
+                return FALSE;
+            c = g_ascii_strtoull (digits, &num_end, 10);
+        }
+
+        if (*num_end != ';')
+            return FALSE;
+        if (c > 0x10FFFF || !g_unichar_validate ((gunichar)c) ||
+            (c < 0x20 && c != '\t' && c != '\n' && c != '\r'))
+            return FALSE;
+
+        *end = num_end + 1;
+        return TRUE;
+    } else {
+        static const gchar *names[] = { "amp", "lt", "gt", "quot", "apos" };
+        gsize len = 0;
+        guint i;
+
+        while (g_ascii_isalpha (q[len]))
+            len++;
+
+        if (q[len] != ';')
+            return FALSE;
+
+        for (i = 0; i < G_N_ELEMENTS (names); i++) {
+            if (strlen (names[i]) == len && strncmp (q, names[i], len) == 0) {
+                *end = q + len + 1;
+                return TRUE;
+            }
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+notify_markup_append_escaped (GString     *out,
+                              const gchar *text,
+                              const gchar *text_end)
+{
+    const gchar *p = text, *entity_end;
+
+    while (p < text_end) {
+        switch (*p) {
+            case '&':
+                if (notify_markup_is_entity (p, &entity_end) && entity_end <= text_end) {
+                    g_string_append_len (out, p, entity_end - p);
+                    p = entity_end;
+                    continue;
+                }
+                g_string_append (out, "&amp;");
+                break;
+            case '<':
+                g_string_append (out, "&lt;");
+                break;
+            case '>':
+                g_string_append (out, "&gt;");
+                break;
+            case '"':
+                g_string_append (out, "&quot;");
+                break;
+            case '\'':
+                g_string_append (out, "&apos;");
+                break;
+            default:
+                if ((guchar)*p >= 0x20 || *p == '\t' || *p == '\n' || *p == '\r')
+                    g_string_append_c (out, *p);
+                break;
+        }
+        p++;
+    }
+}
+
+/* p points after '<'. A '<' before the closing '>' means the first one was
+ * plain text, which also keeps the whole scan linear. */
+static const gchar *
+notify_markup_find_tag_end (const gchar *p)
+{
+    gchar quote = 0;
+
+    for (; *p; p++) {
+        if (quote) {
+            if (*p == quote)
+                quote = 0;
+        } else if (*p == '"' || *p == '\'') {
+            quote = *p;
+        } else if (*p == '>') {
+            return p;
+        } else if (*p == '<') {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/* Returns the raw value of the attribute between p and end. */
+static gboolean
+notify_markup_find_attribute (const gchar  *p,
+                              const gchar  *end,
+                              const gchar  *name,
+                              const gchar **value,
+                              const gchar **value_end)
+{
+    gsize name_len = strlen (name);
+
+    while (p < end) {
+        const gchar *attr = p;
+        gsize attr_len;
+
+        while (p < end && (g_ascii_isalnum (*p) || *p == '-' || *p == '_' || *p == ':'))
+            p++;
+
+        attr_len = p - attr;
+        if (attr_len == 0) {
+            p++;
+            continue;
+        }
+
+        while (p < end && g_ascii_isspace (*p))
+            p++;
+        if (p >= end || *p != '=')
+            continue;
+        p++;
+        while (p < end && g_ascii_isspace (*p))
+            p++;
+
+        if (p < end && (*p == '"' || *p == '\'')) {
+            gchar quote = *p++;
+
+            *value = p;
+            while (p < end && *p != quote)
+                p++;
+            *value_end = p;
+            if (p < end)
+                p++;
+        } else {
+            *value = p;
+            while (p < end && !g_ascii_isspace (*p))
+                p++;
+            *value_end = p;
+        }
+
+        if (attr_len == name_len && g_ascii_strncasecmp (attr, name, name_len) == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Turns a notification body into valid pango markup in a single pass.
+ * The tags of the body-markup and body-hyperlinks subset are kept, <img>
+ * is replaced by its alt text, other tags are dropped and everything else
+ * is escaped. Misnested tags are closed where they stop being valid.
+ * Without keep_links, links become underlined text, since only GtkLabel
+ * knows about <a>. At most max_chars visible characters are kept, 0 means
+ * no limit. */
+gchar *
+notify_markup_sanitize (const gchar *markup,
+                        gsize        max_chars,
+                        gboolean     keep_links)
+{
+    NotifyMarkupOpenTag open_tags[MARKUP_MAX_DEPTH];
+    const gchar *p = markup, *entity_end;
+    guint depth = 0;
+    gsize n = 0;
+    GString *out;
+
+    if (!markup)
+        return NULL;
+
+    out = g_string_sized_new (64);
+
+    while (*p && (max_chars == 0 || n < max_chars)) {
+        if (*p == '<') {
+            const gchar *end = notify_markup_find_tag_end (p + 1);
+            gboolean closing = (p[1] == '/');
+            const gchar *name = p + 1 + closing;
+            const gchar *value, *value_end;
+            gsize name_len = 0;
+            NotifyMarkupTag tag;
+
+            while (g_ascii_isalpha (name[name_len]))
+                name_len++;
+
+            if (!end || name_len == 0 || name + name_len > end) {
+                /* a stray '<' in the text */
+                g_string_append (out, "&lt;");
+                p++;
+                n++;
+                continue;
+            }
+
+            tag = notify_markup_lookup_tag (name, name_len);
+
+            if (closing) {
+                guint i;
+
+                for (i = depth; i > 0; i--) {
+                    if (open_tags[i - 1].tag == tag)
+                        break;
+                }
+
+                if (tag != MARKUP_TAG_UNKNOWN && i > 0) {
+                    while (depth >= i) {
+                        depth--;
+                        g_string_append_printf (out, "</%s>", open_tags[depth].emitted);
+                    }
+                }
+            } else if (tag == MARKUP_TAG_IMG) {
+                if (notify_markup_find_attribute (name + name_len, end, "alt", &value, &value_end)) {
+                    const gchar *alt_end = value;
+
+                    /* the alt text counts against the limit as well */
+                    while (alt_end < value_end && (max_chars == 0 || n < max_chars)) {
+                        alt_end = g_utf8_next_char (alt_end);
+                        n++;
+                    }
+                    notify_markup_append_escaped (out, value, MIN (alt_end, value_end));
+                }
+            } else if (tag != MARKUP_TAG_UNKNOWN && end[-1] != '/' && depth < MARKUP_MAX_DEPTH) {
+                const gchar *emitted;
+
+                if (tag == MARKUP_TAG_A) {
+                    if (keep_links &&
+                        notify_markup_find_attribute (name + name_len, end, "href", &value, &value_end)) {
+                        g_string_append (out, "<a href=\"");
+                        notify_markup_append_escaped (out, value, value_end);
+                        g_string_append (out, "\">");
+                        emitted = "a";
+                    } else {
+                        g_string_append (out, "<u>");
+                        emitted = "u";
+                    }
+                } else {
+                    emitted = tag == MARKUP_TAG_B ? "b" : tag == MARKUP_TAG_I ? "i" : "u";
+                    g_string_append_printf (out, "<%s>", emitted);
+                }
+
+                open_tags[depth].tag = tag;
+                open_tags[depth].emitted = emitted;
+                depth++;
+            }
+
+            p = end + 1;
+        } else if (*p == '&') {
+            if (notify_markup_is_entity (p, &entity_end)) {
+                g_string_append_len (out, p, entity_end - p);
+                p = entity_end;
+            } else {
+                g_string_append (out, "&amp;");
+                p++;
+            }
+            n++;
+        } else if (*p == '>') {
+            g_string_append (out, "&gt;");
+            p++;
+            n++;
+        } else if ((guchar)*p < 0x20 && *p != '\t' && *p != '\n' && *p != '\r') {
+            /* not allowed by GMarkup */
+            p++;
+        } else {
+            const gchar *next = g_utf8_next_char (p);
+
+            g_string_append_len (out, p, next - p);
+            p = next;
+            n++;
+        }
+    }
+
+    while (depth > 0) {
+        depth--;
+        g_string_append_printf (out, "</%s>", open_tags[depth].emitted);
+    }
+
+    return g_string_free (out, FALSE);
+}
@@ -23,6 +23,13 @@
 
 GdkPixbuf  *notify_pixbuf_from_image_data (GVariant *image_data);
 
+void        notify_desktop_index_init (void);
 gchar      *notify_icon_name_from_desktop_id (const gchar *desktop_id);
 
+gchar      *notify_text_truncate (const gchar *text,
+                                  gsize        max_chars);
+gchar      *notify_markup_sanitize (const gchar *markup,
+                                    gsize        max_chars,
+                                    gboolean     keep_links);
+
 #endif /* __COMMON_H__ */
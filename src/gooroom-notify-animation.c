@@ -0,0 +1,329 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* All running animations are advanced from a single frame clock tick
+ * callback. The callback is hosted by one of the animated widgets; when that
+ * widget goes away the driver moves over to another one. Progress is computed
+ * from the frame time, so a late frame never slows an animation down. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gooroom-notify-animation.h"
+
+typedef struct
+{
+	guint                           id;
+	GtkWidget                      *widget;
+	gint64                          start_time;
+	gint64                          duration;
+	GooroomNotifyEasing             easing;
+	GooroomNotifyAnimationStepFunc  step_func;
+	GooroomNotifyAnimationDoneFunc  done_func;
+	gpointer                        user_data;
+	gboolean                        finished;
+} GooroomNotifyAnimation;
+
+/* the data of a tick callback; the id tells a callback that was replaced
+ * from the current one on the same widget */
+typedef struct
+{
+	GtkWidget *widget;
+	guint      id;
+} GooroomNotifyAnimationTick;
+
+static GPtrArray *animations = NULL;
+static GtkWidget *tick_widget = NULL;
+static guint      tick_id = 0;
+static guint      last_animation_id = 0;
+static gboolean   in_tick = FALSE;
+static gboolean   suspended = FALSE;
+static guint64    ticks = 0;
+
+static gboolean gooroom_notify_animation_tick (GtkWidget     *widget,
+                                               GdkFrameClock *frame_clock,
+                                               gpointer       user_data);
+static void gooroom_notify_animation_ensure_tick (GtkWidget *skip);
+
+
+static gdouble
+gooroom_notify_animation_ease (GooroomNotifyEasing easing,
+                               gdouble             t)
+{
+	gdouble p;
+
+	switch (easing) {
+		case GOOROOM_NOTIFY_EASING_EASE_IN_CUBIC:
+			return t * t * t;
+		case GOOROOM_NOTIFY_EASING_EASE_OUT_CUBIC:
+			p = 1.0 - t;
+			return 1.0 - p * p * p;
+		case GOOROOM_NOTIFY_EASING_EASE_IN_OUT_CUBIC:
+			if (t < 0.5)
+				return 4.0 * t * t * t;
+			p = -2.0 * t + 2.0;
+			return 1.0 - p * p * p / 2.0;
+		case GOOROOM_NOTIFY_EASING_LINEAR:
+		default:
+			return t;
+	}
+}
+
+static void
+gooroom_notify_animation_free (gpointer data)
+{
+	GooroomNotifyAnimation *anim = data;
+
+	g_object_unref (anim->widget);
+	g_free (anim);
+}
+
+static void
+gooroom_notify_animation_tick_destroyed (gpointer data)
+{
+	GooroomNotifyAnimationTick *tick = data;
+
+	if (tick->id == tick_id) {
+		tick_widget = NULL;
+		tick_id = 0;
+		if (!in_tick)
+			gooroom_notify_animation_ensure_tick (tick->widget);
+	}
+
+	g_object_unref (tick->widget);
+	g_free (tick);
+}
+
+/* skip is the host being dropped; it is only picked again when no other
+ * widget is animating and it is still alive and realized */
+static void
+gooroom_notify_animation_ensure_tick (GtkWidget *skip)
+{
+	guint i;
+	GooroomNotifyAnimation *host = NULL, *fallback = NULL;
+	GooroomNotifyAnimationTick *tick;
+
+	if (tick_id || !animations)
+		return;
+
+	/* prefer a realized widget, its frame clock is already running */
+	for (i = 0; i < animations->len; i++) {
+		GooroomNotifyAnimation *anim = g_ptr_array_index (animations, i);
+
+		if (anim->finished)
+			continue;
+
+		if (anim->widget == skip) {
+			if (!fallback)
+				fallback = anim;
+			continue;
+		}
+
+		if (!host)
+			host = anim;
+
+		if (gtk_widget_get_realized (anim->widget)) {
+			host = anim;
+			break;
+		}
+	}
+
+	if (!host && fallback && gtk_widget_get_realized (skip) && !gtk_widget_in_destruction (skip))
+		host = fallback;
+
+	if (!host)
+		return;
+
+	tick = g_new0 (GooroomNotifyAnimationTick, 1);
+	tick->widget = g_object_ref (host->widget);
+
+	tick_widget = host->widget;
+	tick_id = tick->id = gtk_widget_add_tick_callback (tick_widget,
+	                                                   gooroom_notify_animation_tick,
+	                                                   tick,
+	                                                   gooroom_notify_animation_tick_destroyed);
+}
+
+static void
+gooroom_notify_animation_sweep (void)
+{
+	guint i = 0;
+
+	while (i < animations->len) {
+		GooroomNotifyAnimation *anim = g_ptr_array_index (animations, i);
+
+		if (anim->finished)
+			g_ptr_array_remove_index (animations, i);
+		else
+			i++;
+	}
+}
+
+static gboolean
+gooroom_notify_animation_tick (GtkWidget     *widget,
+                               GdkFrameClock *frame_clock,
+                               gpointer       user_data)
+{
+	GooroomNotifyAnimationTick *tick = user_data;
+	guint i;
+	gint64 now;
+
+	if (tick->id != tick_id)
+		return G_SOURCE_REMOVE;
+
+	now = gdk_frame_clock_get_frame_time (frame_clock);
+	ticks++;
+
+	in_tick = TRUE;
+
+	/* done callbacks may start new animations, which are appended and picked
+	 * up by this same loop */
+	for (i = 0; i < animations->len; i++) {
+		GooroomNotifyAnimation *anim = g_ptr_array_index (animations, i);
+		gdouble t;
+
+		if (anim->finished)
+			continue;
+
+		if (anim->start_time == 0)
+			anim->start_time = now;
+
+		if (suspended)
+			t = 1.0;
+		else
+			t = CLAMP ((gdouble)(now - anim->start_time) / anim->duration, 0.0, 1.0);
+
+		anim->step_func (anim->widget,
+		                 gooroom_notify_animation_ease (anim->easing, t),
+		                 anim->user_data);
+
+		if (t >= 1.0) {
+			anim->finished = TRUE;
+			if (anim->done_func)
+				anim->done_func (anim->widget, anim->user_data);
+		}
+	}
+
+	in_tick = FALSE;
+
+	gooroom_notify_animation_sweep ();
+
+	if (tick->id != tick_id || !gtk_widget_get_realized (widget)) {
+		/* the host widget was destroyed by one of the done callbacks */
+		if (tick->id == tick_id) {
+			tick_widget = NULL;
+			tick_id = 0;
+		}
+		gooroom_notify_animation_ensure_tick (widget);
+		return G_SOURCE_REMOVE;
+	}
+
+	if (animations->len == 0) {
+		tick_widget = NULL;
+		tick_id = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+guint
+gooroom_notify_animation_start (GtkWidget                      *widget,
+                                guint                           duration,
+                                GooroomNotifyEasing             easing,
+                                GooroomNotifyAnimationStepFunc  step_func,
+                                GooroomNotifyAnimationDoneFunc  done_func,
+                                gpointer                        user_data)
+{
+	GooroomNotifyAnimation *anim;
+
+	g_return_val_if_fail (GTK_IS_WIDGET (widget) && step_func, 0);
+
+	if (!animations)
+		animations = g_ptr_array_new_with_free_func (gooroom_notify_animation_free);
+
+	anim = g_new0 (GooroomNotifyAnimation, 1);
+	anim->id = ++last_animation_id;
+	if (G_UNLIKELY (anim->id == 0))
+		anim->id = ++last_animation_id;
+	anim->widget = g_object_ref (widget);
+	anim->duration = (gint64)MAX (duration, 1) * 1000;
+	anim->easing = easing;
+	anim->step_func = step_func;
+	anim->done_func = done_func;
+	anim->user_data = user_data;
+
+	g_ptr_array_add (animations, anim);
+
+	gooroom_notify_animation_ensure_tick (NULL);
+
+	return anim->id;
+}
+
+void
+gooroom_notify_animation_cancel (guint id)
+{
+	guint i;
+
+	if (!animations || id == 0)
+		return;
+
+	for (i = 0; i < animations->len; i++) {
+		GooroomNotifyAnimation *anim = g_ptr_array_index (animations, i);
+		GtkWidget *widget;
+
+		if (anim->id != id)
+			continue;
+
+		if (in_tick) {
+			/* swept once the running tick is over */
+			anim->finished = TRUE;
+			return;
+		}
+
+		widget = g_object_ref (anim->widget);
+		g_ptr_array_remove_index (animations, i);
+
+		if (widget == tick_widget) {
+			/* the host may be about to be unrealized, hand the tick over */
+			guint old_tick_id = tick_id;
+
+			tick_widget = NULL;
+			tick_id = 0;
+			gtk_widget_remove_tick_callback (widget, old_tick_id);
+			gooroom_notify_animation_ensure_tick (widget);
+		}
+
+		g_object_unref (widget);
+		return;
+	}
+}
+
+void
+gooroom_notify_animation_set_suspended (gboolean enabled)
+{
+	suspended = !!enabled;
+}
+
+guint64
+gooroom_notify_animation_get_ticks (void)
+{
+	return ticks;
+}
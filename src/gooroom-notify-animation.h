@@ -0,0 +1,59 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_ANIMATION_H__
+#define __GOOROOM_NOTIFY_ANIMATION_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+    GOOROOM_NOTIFY_EASING_LINEAR = 0,
+    GOOROOM_NOTIFY_EASING_EASE_IN_CUBIC,
+    GOOROOM_NOTIFY_EASING_EASE_OUT_CUBIC,
+    GOOROOM_NOTIFY_EASING_EASE_IN_OUT_CUBIC,
+} GooroomNotifyEasing;
+
+/* progress is already eased and runs from 0.0 to 1.0 */
+typedef void (*GooroomNotifyAnimationStepFunc) (GtkWidget *widget,
+                                                gdouble    progress,
+                                                gpointer   user_data);
+
+typedef void (*GooroomNotifyAnimationDoneFunc) (GtkWidget *widget,
+                                                gpointer   user_data);
+
+guint gooroom_notify_animation_start  (GtkWidget                      *widget,
+                                       guint                           duration,
+                                       GooroomNotifyEasing             easing,
+                                       GooroomNotifyAnimationStepFunc  step_func,
+                                       GooroomNotifyAnimationDoneFunc  done_func,
+                                       gpointer                        user_data);
+
+void  gooroom_notify_animation_cancel (guint id);
+
+/* while suspended, every animation jumps to its end on the next frame */
+void    gooroom_notify_animation_set_suspended (gboolean suspended);
+
+guint64 gooroom_notify_animation_get_ticks     (void);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_ANIMATION_H__ */
@@ -38,10 +38,41 @@
 #include "common.h"
 #include "gooroom-notify-gbus.h"
 #include "gooroom-notify-daemon.h"
+#include "gooroom-notify-animation.h"
+#include "gooroom-notify-disk-cache.h"
+#include "gooroom-notify-history.h"
+#include "gooroom-notify-icon-atlas.h"
+#include "gooroom-notify-id-index.h"
+#include "gooroom-notify-intern.h"
+#include "gooroom-notify-icon-cache.h"
+#include "gooroom-notify-timer.h"
 #include "gooroom-notify-window.h"
+#include "gooroom-notify-overlay.h"
+#include "gooroom-notify-policy.h"
+#include "gooroom-notify-record.h"
 #include "gooroom-notify-marshal.h"
 
 #define SPACE 0
+
+/* Visible lines of the summary and body labels. Text far beyond what fits
+ * in them is ellipsized anyway, but pango would still shape all of it. */
+#define SUMMARY_LINES     1
+#define BODY_LINES        2
+#define TEXT_BUDGET_SLACK 4
+
+/* Notifications held back by "Do not disturb" wait without a window until
+ * it is turned off. Past either bound the oldest ones are dropped. */
+#define DEFERRED_MAX_RECORDS 100
+#define DEFERRED_MAX_BYTES   (1024 * 1024)
+
+/* when "Do not disturb" ends, an app with more deferred notifications than
+ * this gets a single digest instead, and the rest come one at a time */
+#define DIGEST_THRESHOLD  3
+#define RELEASE_INTERVAL  (1 * 1000)
+
+/* how long a replacing daemon waits for the running one */
+#define HANDOVER_TIMEOUT (3 * 1000)
+
 #define XND_N_MONITORS gooroom_notify_daemon_get_n_monitors_quark()
 
 struct _GooroomNotifyDaemon
@@ -56,13 +87,41 @@ struct _GooroomNotifyDaemon
 	gboolean do_fadeout;
 	gboolean do_slideout;
 	gboolean do_not_disturb;
+	gboolean use_overlay;
+	gboolean power_saving;
 	gint primary_monitor;
 
+	/* org.gnome.ScreenSaver ActiveChanged, the screen is blanked or locked */
+	gboolean screensaver_active;
+	guint screensaver_watch_id;
+	GDBusConnection *connection;
+
+	/* TransferState was answered and the name released to the caller,
+	 * the successor; calls still on their way here are passed on to it
+	 * until this instance quits */
+	gboolean handed_over;
+	gchar *successor;
+	guint handover_source_id;
+
+	/* the previous GetStats call, for the wakeup rate */
+	gint64 stats_time;
+	guint64 stats_wakeups;
+
+	/* tracked through GdkScreen::composited-changed */
+	gboolean composited;
+
 	GSettings *settings;
 
-	GTree *active_notifications;
+	GooroomNotifyIdIndex *active_notifications;
+	/* GetActiveNotifications, until a notification comes, goes or changes */
+	GVariant *snapshot;
+	/* records held back by "Do not disturb", oldest first */
+	GQueue *deferred;
+	gsize deferred_bytes;
+	guint release_timer_id;
 	GList **reserved_rectangles;
 	GdkRectangle *monitors_workarea;
+	GtkWidget **overlays;
 
 	guint32 last_notification_id;
 };
@@ -83,9 +142,9 @@ enum
 
 static void gooroom_notify_daemon_screen_changed (GdkScreen *screen,
                                                   gpointer   user_data);
-static gboolean gooroom_notify_daemon_update_reserved_rectangles (gpointer key,
-                                                                  gpointer value,
-                                                                  gpointer data);
+static void gooroom_notify_daemon_update_reserved_rectangles (guint32  id,
+                                                              gpointer value,
+                                                              gpointer data);
 static void gooroom_notify_daemon_finalize(GObject *obj);
 static void  gooroom_notify_daemon_constructed(GObject *obj);
 
@@ -132,6 +191,30 @@ static gboolean notify_get_server_information (GooroomNotifyGBus *skeleton,
                                                GooroomNotifyDaemon *xndaemon);
 
 
+static gboolean notify_get_active_notifications (GooroomNotifyKrGooroomNotifyd *skeleton,
+                                                 GDBusMethodInvocation         *invocation,
+                                                 GooroomNotifyDaemon           *xndaemon);
+
+static gboolean notify_transfer_state (GooroomNotifyKrGooroomNotifyd *skeleton,
+                                       GDBusMethodInvocation         *invocation,
+                                       GooroomNotifyDaemon           *xndaemon);
+
+static void gooroom_notify_daemon_restore_state (GooroomNotifyDaemon *xndaemon,
+                                                 GVariant            *state);
+static void gooroom_notify_daemon_forward_call (GooroomNotifyDaemon   *xndaemon,
+                                                GDBusMethodInvocation *invocation);
+
+static gboolean notify_get_history (GooroomNotifyKrGooroomNotifyd *skeleton,
+                                    GDBusMethodInvocation         *invocation,
+                                    guint                          offset,
+                                    guint                          limit,
+                                    GVariant                      *filter,
+                                    GooroomNotifyDaemon           *xndaemon);
+
+static gboolean notify_get_stats (GooroomNotifyKrGooroomNotifyd *skeleton,
+                                  GDBusMethodInvocation *invocation,
+                                  GooroomNotifyDaemon *xndaemon);
+
 static gboolean notify_quit (GooroomNotifyKrGooroomNotifyd *skeleton,
                              GDBusMethodInvocation   *invocation,
                              GooroomNotifyDaemon *xndaemon);
@@ -149,14 +232,6 @@ gooroom_notify_daemon_class_init (GooroomNotifyDaemonClass *klass)
     gobject_class->constructed = gooroom_notify_daemon_constructed;
 }
 
-static gint
-gooroom_direct_compare(gconstpointer a,
-                       gconstpointer b,
-                       gpointer      user_data)
-{
-	return (gint)((gchar *)a - (gchar *)b);
-}
-
 
 static GQuark
 gooroom_notify_daemon_get_n_monitors_quark (void)
@@ -234,12 +309,44 @@ gooroom_notify_rootwin_watch_workarea (GdkXEvent *gxevent,
 	return GDK_FILTER_CONTINUE;
 }
 
+static void
+gooroom_notify_daemon_free_overlays (GtkWidget **overlays,
+                                     gint        n_overlays)
+{
+	gint i;
+
+	if (!overlays)
+		return;
+
+	for (i = 0; i < n_overlays; i++) {
+		if (overlays[i])
+			gtk_widget_destroy (overlays[i]);
+	}
+
+	g_free (overlays);
+}
+
+static GooroomNotifyOverlay *
+gooroom_notify_daemon_get_overlay (GooroomNotifyDaemon *xndaemon,
+                                   gint                 monitor)
+{
+	if (!xndaemon->overlays[monitor]) {
+		GdkDisplay *display = gdk_display_get_default ();
+
+		xndaemon->overlays[monitor] = gooroom_notify_overlay_new (gdk_display_get_monitor (display, monitor),
+		                                                          xndaemon->composited);
+	}
+
+	return GOOROOM_NOTIFY_OVERLAY (xndaemon->overlays[monitor]);
+}
+
 static void
 gooroom_notify_daemon_screen_changed (GdkScreen *screen, gpointer user_data)
 {
 	gint j;
 	gint new_nmonitor;
 	gint old_nmonitor;
+	GtkWidget **old_overlays;
 	GooroomNotifyDaemon *xndaemon = GOOROOM_NOTIFY_DAEMON(user_data);
 
 	if (!xndaemon->monitors_workarea || !xndaemon->reserved_rectangles) {
@@ -268,10 +375,60 @@ gooroom_notify_daemon_screen_changed (GdkScreen *screen, gpointer user_data)
     /* Initialize a new reserved rectangles array for screen */
 	xndaemon->reserved_rectangles = g_new0 (GList *, new_nmonitor);
 
+	/* The overlays cover the old monitor layout, notifications move over to
+	 * new ones while being placed again */
+	old_overlays = xndaemon->overlays;
+	xndaemon->overlays = g_new0 (GtkWidget *, new_nmonitor);
+
     /* Traverse the active notifications tree to fill the new reserved rectangles array for screen */
-	g_tree_foreach (xndaemon->active_notifications,
-                    (GTraverseFunc)gooroom_notify_daemon_update_reserved_rectangles,
-                    xndaemon);
+	gooroom_notify_id_index_foreach (xndaemon->active_notifications,
+                                     gooroom_notify_daemon_update_reserved_rectangles,
+                                     xndaemon);
+
+	gooroom_notify_daemon_free_overlays (old_overlays, old_nmonitor);
+}
+
+static void
+gooroom_notify_daemon_update_composited (guint32  id,
+                                         gpointer value,
+                                         gpointer data)
+{
+	GooroomNotifyDaemon *xndaemon = GOOROOM_NOTIFY_DAEMON (data);
+	GooroomNotifyRecord *record = value;
+	GooroomNotifyWindow *window;
+
+	if (!record->window)
+		return;
+
+	window = GOOROOM_NOTIFY_WINDOW (record->window);
+	gooroom_notify_window_set_fade_transparent (window, xndaemon->composited);
+
+	if (gooroom_notify_window_get_overlay (window)) {
+		gint monitor = gooroom_notify_window_get_last_monitor (window);
+		gooroom_notify_overlay_add (gooroom_notify_daemon_get_overlay (xndaemon, monitor), window);
+	}
+}
+
+static void
+gooroom_notify_daemon_composited_changed (GdkScreen *screen, gpointer user_data)
+{
+	gint nmonitor;
+	GtkWidget **old_overlays;
+	GooroomNotifyDaemon *xndaemon = GOOROOM_NOTIFY_DAEMON (user_data);
+
+	xndaemon->composited = gdk_screen_is_composited (screen);
+
+	/* the overlays are created again with a matching visual */
+	nmonitor = GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (screen), XND_N_MONITORS));
+	old_overlays = xndaemon->overlays;
+	if (old_overlays)
+		xndaemon->overlays = g_new0 (GtkWidget *, nmonitor);
+
+	gooroom_notify_id_index_foreach (xndaemon->active_notifications,
+                                     gooroom_notify_daemon_update_composited,
+                                     xndaemon);
+
+	gooroom_notify_daemon_free_overlays (old_overlays, nmonitor);
 }
 
 static void
@@ -289,6 +446,7 @@ gooroom_notify_daemon_init_placement_data (GooroomNotifyDaemon *xndaemon)
 
 	xndaemon->reserved_rectangles = g_new0(GList *, nmonitor);
 	xndaemon->monitors_workarea = g_new0(GdkRectangle, nmonitor);
+	xndaemon->overlays = g_new0(GtkWidget *, nmonitor);
 
 	for(j = 0; j < nmonitor; j++)
 		gooroom_notify_daemon_get_workarea (screen, j, &(xndaemon->monitors_workarea[j]));
@@ -300,16 +458,103 @@ gooroom_notify_daemon_init_placement_data (GooroomNotifyDaemon *xndaemon)
 }
 
 static void
-gooroom_notify_bus_name_acquired_cb (GDBusConnection *connection,
-                                  const gchar *name,
-                                  gpointer user_data)
+gooroom_notify_daemon_update_power_state (GooroomNotifyDaemon *xndaemon)
+{
+	/* nothing can be seen while the screensaver is up, so nothing has to
+	 * expire or move either */
+	gboolean suspended = (xndaemon->power_saving && xndaemon->screensaver_active) ||
+	                     xndaemon->handed_over;
+
+	gooroom_notify_timer_set_coarse (xndaemon->power_saving);
+	gooroom_notify_timer_set_suspended (suspended);
+	gooroom_notify_animation_set_suspended (suspended);
+}
+
+static void
+gooroom_notify_daemon_screensaver_changed (GDBusConnection *connection,
+                                           const gchar     *sender_name,
+                                           const gchar     *object_path,
+                                           const gchar     *interface_name,
+                                           const gchar     *signal_name,
+                                           GVariant        *parameters,
+                                           gpointer         user_data)
+{
+	GooroomNotifyDaemon *xndaemon = GOOROOM_NOTIFY_DAEMON (user_data);
+
+	if (!g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(b)")))
+		return;
+
+	g_variant_get (parameters, "(b)", &xndaemon->screensaver_active);
+	gooroom_notify_daemon_update_power_state (xndaemon);
+}
+
+static void
+gooroom_notify_daemon_screensaver_get_active_cb (GObject      *source_object,
+                                                 GAsyncResult *res,
+                                                 gpointer      user_data)
 {
 	GooroomNotifyDaemon *xndaemon;
+	GVariant *ret;
+
+	/* without a screensaver the session counts as active */
+	ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, NULL);
+	if (!ret) {
+		g_object_unref (user_data);
+		return;
+	}
+
+	xndaemon = GOOROOM_NOTIFY_DAEMON (user_data);
+	g_variant_get (ret, "(b)", &xndaemon->screensaver_active);
+	gooroom_notify_daemon_update_power_state (xndaemon);
+
+	g_variant_unref (ret);
+	g_object_unref (xndaemon);
+}
+
+static void
+gooroom_notify_daemon_watch_screensaver (GooroomNotifyDaemon *xndaemon,
+                                         GDBusConnection     *connection)
+{
+	if (xndaemon->screensaver_watch_id)
+		return;
+
+	xndaemon->connection = g_object_ref (connection);
+	xndaemon->screensaver_watch_id =
+		g_dbus_connection_signal_subscribe (connection,
+		                                    NULL,
+		                                    "org.gnome.ScreenSaver",
+		                                    "ActiveChanged",
+		                                    "/org/gnome/ScreenSaver",
+		                                    NULL,
+		                                    G_DBUS_SIGNAL_FLAGS_NONE,
+		                                    gooroom_notify_daemon_screensaver_changed,
+		                                    xndaemon,
+		                                    NULL);
+
+	g_dbus_connection_call (connection,
+	                        "org.gnome.ScreenSaver",
+	                        "/org/gnome/ScreenSaver",
+	                        "org.gnome.ScreenSaver",
+	                        "GetActive",
+	                        NULL,
+	                        G_VARIANT_TYPE ("(b)"),
+	                        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                        -1,
+	                        NULL,
+	                        gooroom_notify_daemon_screensaver_get_active_cb,
+	                        g_object_ref (xndaemon));
+}
+
+/* Exported before the name is asked for: calls reach this instance as
+ * soon as the bus hands the name over, which may be in the middle of a
+ * handover. */
+static void
+gooroom_notify_daemon_export (GooroomNotifyDaemon *xndaemon,
+                              GDBusConnection     *connection)
+{
 	GError *error = NULL;
 	gboolean exported;
 
-	xndaemon = GOOROOM_NOTIFY_DAEMON(user_data);
-
 	exported =  g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (xndaemon),
                                                   connection,
                                                   "/org/freedesktop/Notifications",
@@ -341,11 +586,21 @@ gooroom_notify_bus_name_acquired_cb (GDBusConnection *connection,
 	if (exported) {
 		g_signal_connect (xndaemon->gooroom_iface_skeleton, "handle-quit",
                           G_CALLBACK(notify_quit), xndaemon);
+		g_signal_connect (xndaemon->gooroom_iface_skeleton, "handle-get-stats",
+                          G_CALLBACK(notify_get_stats), xndaemon);
+		g_signal_connect (xndaemon->gooroom_iface_skeleton, "handle-get-history",
+                          G_CALLBACK(notify_get_history), xndaemon);
+		g_signal_connect (xndaemon->gooroom_iface_skeleton, "handle-get-active-notifications",
+                          G_CALLBACK(notify_get_active_notifications), xndaemon);
+		g_signal_connect (xndaemon->gooroom_iface_skeleton, "handle-transfer-state",
+                          G_CALLBACK(notify_transfer_state), xndaemon);
 	} else {
 		g_warning ("Failed to export interface: %s", error->message);
 		g_error_free (error);
 		gtk_main_quit ();
 	}
+
+	gooroom_notify_daemon_watch_screensaver (xndaemon, connection);
 }
 
 static void
@@ -356,6 +611,94 @@ gooroom_notify_bus_name_lost_cb (GDBusConnection *connection,
 	daemon_quit (GOOROOM_NOTIFY_DAEMON(user_data));
 }
 
+static void
+gooroom_notify_daemon_transfer_state_cb (GObject      *source_object,
+                                         GAsyncResult *res,
+                                         gpointer      user_data)
+{
+	GooroomNotifyDaemon *self = GOOROOM_NOTIFY_DAEMON (user_data);
+	GDBusConnection *connection = G_DBUS_CONNECTION (source_object);
+	GVariant *ret, *state;
+
+	ret = g_dbus_connection_call_finish (connection, res, NULL);
+	if (ret) {
+		/* the running daemon released the name right after replying, the
+		 * bus passes it on to this instance next */
+		g_variant_get (ret, "(@a{sv})", &state);
+		gooroom_notify_daemon_restore_state (self, state);
+		g_variant_unref (state);
+		g_variant_unref (ret);
+	} else {
+		/* no daemon runs, this one has the name already, or it runs
+		 * without TransferState and has to be replaced */
+		g_dbus_connection_call (connection,
+		                        "org.freedesktop.DBus",
+		                        "/org/freedesktop/DBus",
+		                        "org.freedesktop.DBus",
+		                        "RequestName",
+		                        g_variant_new ("(su)", "org.freedesktop.Notifications",
+		                                       G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT |
+		                                       G_BUS_NAME_OWNER_FLAGS_REPLACE),
+		                        NULL,
+		                        G_DBUS_CALL_FLAGS_NONE,
+		                        -1,
+		                        NULL,
+		                        NULL,
+		                        NULL);
+	}
+
+	g_object_unref (self);
+}
+
+static void
+gooroom_notify_daemon_bus_get_cb (GObject      *source_object,
+                                  GAsyncResult *res,
+                                  gpointer      user_data)
+{
+	GooroomNotifyDaemon *self = GOOROOM_NOTIFY_DAEMON (user_data);
+	GDBusConnection *connection;
+	GError *error = NULL;
+
+	connection = g_bus_get_finish (res, &error);
+	if (!connection) {
+		g_warning ("Failed to connect to the session bus: %s", error->message);
+		g_error_free (error);
+		daemon_quit (self);
+		g_object_unref (self);
+		return;
+	}
+
+	gooroom_notify_daemon_export (self, connection);
+
+	/* Queued behind the running daemon, which only hands its notifications
+	 * over to a queued owner. It replies with them and releases the name,
+	 * so they stay on screen, keep their ids and no call is refused. */
+	self->bus_name_id = g_bus_own_name_on_connection (connection,
+	                                                  "org.freedesktop.Notifications",
+	                                                  G_BUS_NAME_OWNER_FLAGS_ALLOW_REPLACEMENT,
+	                                                  NULL,
+	                                                  gooroom_notify_bus_name_lost_cb,
+	                                                  self,
+	                                                  NULL);
+
+	/* sent after RequestName, so the bus has queued this instance by the
+	 * time the running one asks */
+	g_dbus_connection_call (connection,
+	                        "org.freedesktop.Notifications",
+	                        "/org/freedesktop/Notifications",
+	                        "kr.gooroom.Notifyd",
+	                        "TransferState",
+	                        NULL,
+	                        G_VARIANT_TYPE ("(a{sv})"),
+	                        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                        HANDOVER_TIMEOUT,
+	                        NULL,
+	                        gooroom_notify_daemon_transfer_state_cb,
+	                        self);
+
+	g_object_unref (connection);
+}
+
 static void
 gooroom_notify_daemon_constructed (GObject *obj)
 {
@@ -363,26 +706,31 @@ gooroom_notify_daemon_constructed (GObject *obj)
 
 	self  = GOOROOM_NOTIFY_DAEMON (obj);
 
-	self->bus_name_id = g_bus_own_name (G_BUS_TYPE_SESSION,
-                                        "org.freedesktop.Notifications",
-                                        G_BUS_NAME_OWNER_FLAGS_REPLACE,
-                                        gooroom_notify_bus_name_acquired_cb,
-                                        NULL,
-                                        gooroom_notify_bus_name_lost_cb,
-                                        self,
-                                        NULL);
+	g_bus_get (G_BUS_TYPE_SESSION, NULL, gooroom_notify_daemon_bus_get_cb, g_object_ref (self));
 }
 
 static void
 gooroom_notify_daemon_init (GooroomNotifyDaemon *xndaemon)
 {
-	xndaemon->active_notifications = g_tree_new_full (gooroom_direct_compare,
-                                                      NULL, NULL,
-                                                      (GDestroyNotify)gtk_widget_destroy);
+	GdkScreen *screen = gdk_screen_get_default ();
+
+	xndaemon->active_notifications = gooroom_notify_id_index_new ((GDestroyNotify)gooroom_notify_record_free);
+	xndaemon->deferred = g_queue_new ();
 
 	xndaemon->last_notification_id = 1;
 	xndaemon->reserved_rectangles = NULL;
 	xndaemon->monitors_workarea = NULL;
+	xndaemon->overlays = NULL;
+
+	notify_desktop_index_init ();
+	gooroom_notify_disk_cache_trim (GOOROOM_NOTIFY_DISK_CACHE_DEFAULT_BUDGET);
+	gooroom_notify_icon_atlas_open (ICON_ATLAS_FILE);
+
+	xndaemon->stats_time = g_get_monotonic_time ();
+
+	xndaemon->composited = gdk_screen_is_composited (screen);
+	g_signal_connect (G_OBJECT (screen), "composited-changed",
+                      G_CALLBACK (gooroom_notify_daemon_composited_changed), xndaemon);
 }
 
 static void
@@ -391,6 +739,18 @@ gooroom_notify_daemon_finalize (GObject *obj)
 	GooroomNotifyDaemon *xndaemon = GOOROOM_NOTIFY_DAEMON (obj);
 	GDBusConnection *connection;
 
+	g_signal_handlers_disconnect_by_func (gdk_screen_get_default (),
+                                          gooroom_notify_daemon_composited_changed,
+                                          xndaemon);
+
+	if (xndaemon->handover_source_id)
+		g_source_remove (xndaemon->handover_source_id);
+	g_free (xndaemon->successor);
+
+	if (xndaemon->screensaver_watch_id)
+		g_dbus_connection_signal_unsubscribe (xndaemon->connection, xndaemon->screensaver_watch_id);
+	g_clear_object (&xndaemon->connection);
+
 	connection = g_dbus_interface_skeleton_get_connection (G_DBUS_INTERFACE_SKELETON (xndaemon));
 
 	if (g_dbus_interface_skeleton_has_connection (G_DBUS_INTERFACE_SKELETON (xndaemon),
@@ -421,7 +781,22 @@ gooroom_notify_daemon_finalize (GObject *obj)
 		g_free (xndaemon->monitors_workarea);
 	}
 
-	g_tree_destroy (xndaemon->active_notifications);
+	if (xndaemon->release_timer_id)
+		gooroom_notify_timer_cancel (xndaemon->release_timer_id);
+	/* the records themselves go with the index */
+	g_queue_free (xndaemon->deferred);
+
+	gooroom_notify_id_index_free (xndaemon->active_notifications);
+	if (xndaemon->snapshot)
+		g_variant_unref (xndaemon->snapshot);
+	gooroom_notify_history_close ();
+
+	if (xndaemon->overlays) {
+		GdkScreen *screen = gdk_screen_get_default ();
+		gint nmonitor = GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (screen), XND_N_MONITORS));
+
+		gooroom_notify_daemon_free_overlays (xndaemon->overlays, nmonitor);
+	}
 
 	if (xndaemon->settings)
 		g_object_unref (xndaemon->settings);
@@ -449,6 +824,54 @@ gooroom_notify_daemon_window_action_invoked (GooroomNotifyWindow *window,
 	gooroom_notify_gbus_emit_action_invoked (GOOROOM_NOTIFY_GBUS(xndaemon), id, action);
 }
 
+static void
+gooroom_notify_daemon_record_changed (GooroomNotifyDaemon *xndaemon,
+                                      GooroomNotifyRecord *record)
+{
+	if (record && record->snapshot) {
+		g_variant_unref (record->snapshot);
+		record->snapshot = NULL;
+	}
+
+	if (xndaemon->snapshot) {
+		g_variant_unref (xndaemon->snapshot);
+		xndaemon->snapshot = NULL;
+	}
+}
+
+static void
+gooroom_notify_daemon_undefer_record (GooroomNotifyDaemon *xndaemon,
+                                      GooroomNotifyRecord *record)
+{
+	if (!record->deferred_size)
+		return;
+
+	g_queue_remove (xndaemon->deferred, record);
+	xndaemon->deferred_bytes -= record->deferred_size;
+	record->deferred_size = 0;
+}
+
+static void
+gooroom_notify_daemon_record_closed (GooroomNotifyDaemon      *xndaemon,
+                                     GooroomNotifyRecord      *record,
+                                     GooroomNotifyCloseReason  reason)
+{
+	guint32 id = record->id;
+
+	gooroom_notify_daemon_undefer_record (xndaemon, record);
+
+	gooroom_notify_history_append (id, record->timestamp, record->app_name,
+	                               gooroom_notify_record_get_summary (record),
+	                               gooroom_notify_record_get_body (record),
+	                               reason);
+
+	gooroom_notify_id_index_remove (xndaemon->active_notifications, id);
+	gooroom_notify_daemon_record_changed (xndaemon, NULL);
+
+	gooroom_notify_gbus_emit_notification_closed (GOOROOM_NOTIFY_GBUS (xndaemon),
+	                                              id, (guint)reason);
+}
+
 static void
 gooroom_notify_daemon_window_closed (GooroomNotifyWindow      *window,
                                      GooroomNotifyCloseReason  reason,
@@ -456,7 +879,9 @@ gooroom_notify_daemon_window_closed (GooroomNotifyWindow      *window,
 {
 	GooroomNotifyDaemon *xndaemon = user_data;
 	gpointer id_p = g_object_get_data (G_OBJECT (window), "--notify-id");
+	GooroomNotifyRecord *record;
 	GList *list;
+	GtkWidget *overlay;
 	gint monitor = gooroom_notify_window_get_last_monitor(window);
 
 	/* Remove the reserved rectangle from the list */
@@ -464,11 +889,13 @@ gooroom_notify_daemon_window_closed (GooroomNotifyWindow      *window,
 	list = g_list_remove (list, gooroom_notify_window_get_geometry (window));
 	xndaemon->reserved_rectangles[monitor] = list;
 
-	g_tree_remove (xndaemon->active_notifications, id_p);
+	overlay = gooroom_notify_window_get_overlay (window);
+	if (overlay)
+		gooroom_notify_overlay_remove (GOOROOM_NOTIFY_OVERLAY (overlay), window);
 
-    gooroom_notify_gbus_emit_notification_closed (GOOROOM_NOTIFY_GBUS(xndaemon),
-                                                  GPOINTER_TO_UINT(id_p),
-                                                  (guint)reason);
+	record = gooroom_notify_id_index_lookup (xndaemon->active_notifications, GPOINTER_TO_UINT (id_p));
+	if (record)
+		gooroom_notify_daemon_record_closed (xndaemon, record, reason);
 }
 
 /* Gets the largest rectangle in src1 which does not contain src2.
@@ -716,6 +1143,25 @@ G_GNUC_END_IGNORE_DEPRECATIONS
 	g_list_free (windows_list);
 }
 
+static inline gboolean
+gooroom_notify_daemon_window_is_overlaid (GooroomNotifyWindow *window)
+{
+	return GPOINTER_TO_INT (g_object_get_data (G_OBJECT (window), "--notify-overlay"));
+}
+
+static void
+gooroom_notify_daemon_window_move (GooroomNotifyDaemon *xndaemon,
+                                   GooroomNotifyWindow *window,
+                                   gint                 monitor)
+{
+	GdkRectangle *geom = gooroom_notify_window_get_geometry (window);
+
+	if (gooroom_notify_daemon_window_is_overlaid (window))
+		gooroom_notify_overlay_add (gooroom_notify_daemon_get_overlay (xndaemon, monitor), window);
+	else
+		gtk_window_move (GTK_WINDOW (window), geom->x, geom->y);
+}
+
 static void
 gooroom_notify_daemon_window_size_allocate (GtkWidget *widget,
                                             GtkAllocation *allocation,
@@ -831,7 +1277,7 @@ gooroom_notify_daemon_window_size_allocate (GtkWidget *widget,
 		list = g_list_prepend(list, gooroom_notify_window_get_geometry (GOOROOM_NOTIFY_WINDOW (widget)));
 		xndaemon->reserved_rectangles[monitor] = list;
 
-		gtk_window_move (GTK_WINDOW (widget), widget_geom.x, widget_geom.y);
+		gooroom_notify_daemon_window_move (xndaemon, window, monitor);
 		return;
     } else {
 		/* Else, we try to find the appropriate position on the monitor */
@@ -931,22 +1377,31 @@ gooroom_notify_daemon_window_size_allocate (GtkWidget *widget,
 	list = g_list_prepend (list, gooroom_notify_window_get_geometry (GOOROOM_NOTIFY_WINDOW (widget)));
 	xndaemon->reserved_rectangles[monitor] = list;
 
-	gtk_window_move (GTK_WINDOW (widget), widget_geom.x, widget_geom.y);
+	gooroom_notify_daemon_window_move (xndaemon, window, monitor);
 }
 
 
-static gboolean
-gooroom_notify_daemon_update_reserved_rectangles (gpointer key,
+static void
+gooroom_notify_daemon_update_reserved_rectangles (guint32  id,
                                                   gpointer value,
                                                   gpointer data)
 {
 	GooroomNotifyDaemon *xndaemon = GOOROOM_NOTIFY_DAEMON (data);
-	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (value);
+	GooroomNotifyRecord *record = value;
+	GooroomNotifyWindow *window;
 	gint width, height;
 	GtkAllocation allocation;
 
+	if (!record->window)
+		return;
+
+	window = GOOROOM_NOTIFY_WINDOW (record->window);
+
     /* Get the size of the notification */
-	gtk_window_get_size (GTK_WINDOW (window), &width, &height);
+	if (gooroom_notify_daemon_window_is_overlaid (window))
+		gooroom_notify_overlay_measure (window, &width, &height);
+	else
+		gtk_window_get_size (GTK_WINDOW (window), &width, &height);
 
 	allocation.x = 0;
 	allocation.y = 0;
@@ -954,8 +1409,6 @@ gooroom_notify_daemon_update_reserved_rectangles (gpointer key,
 	allocation.height = height;
 
 	gooroom_notify_daemon_window_size_allocate (GTK_WIDGET (window), &allocation, xndaemon);
-
-	return FALSE;
 }
 
 static gboolean
@@ -974,6 +1427,24 @@ notify_get_capabilities (GooroomNotifyGBus     *skeleton,
 	return TRUE;
 }
 
+/* The labels are at most monitor width / 40 characters wide, see
+ * gooroom_notify_window_init (). The slack covers narrow glyphs. */
+static gsize
+gooroom_notify_daemon_get_text_budget (gint lines)
+{
+	gint i, width = 0;
+	GdkDisplay *display = gdk_display_get_default ();
+
+	for (i = 0; i < gdk_display_get_n_monitors (display); i++) {
+		GdkRectangle geometry;
+
+		gdk_monitor_get_geometry (gdk_display_get_monitor (display, i), &geometry);
+		width = MAX (width, geometry.width);
+	}
+
+	return (gsize)MAX (width / 40, 1) * lines * TEXT_BUDGET_SLACK;
+}
+
 static gboolean
 notify_show_window (gpointer window)
 {
@@ -982,6 +1453,260 @@ notify_show_window (gpointer window)
 	return FALSE;
 }
 
+static void
+gooroom_notify_daemon_show_record (GooroomNotifyDaemon *xndaemon,
+                                   GooroomNotifyRecord *record)
+{
+	GooroomNotifyWindow *window;
+	const gchar *summary = gooroom_notify_record_get_summary (record);
+	const gchar *body = gooroom_notify_record_get_body (record);
+
+	gooroom_notify_daemon_undefer_record (xndaemon, record);
+	record->state = GOOROOM_NOTIFY_RECORD_SHOWN;
+
+	if (record->window) {
+		window = GOOROOM_NOTIFY_WINDOW (record->window);
+		gooroom_notify_window_set_summary (window, summary);
+		gooroom_notify_window_set_body (window, body);
+		gooroom_notify_window_set_actions (window, (const gchar **)record->actions);
+		gooroom_notify_window_set_expire_timeout (window, record->expire_timeout);
+		gooroom_notify_window_set_opacity (window, xndaemon->initial_opacity);
+	} else {
+		window = GOOROOM_NOTIFY_WINDOW (gooroom_notify_window_new_with_actions (summary, body, NULL,
+		                                                                        record->expire_timeout,
+		                                                                        (const gchar **)record->actions));
+		gooroom_notify_window_set_opacity (window, xndaemon->initial_opacity);
+		gooroom_notify_window_set_fade_transparent (window, xndaemon->composited);
+
+		g_object_set_data (G_OBJECT(window), "--notify-id", GUINT_TO_POINTER (record->id));
+		record->window = GTK_WIDGET (window);
+
+		g_signal_connect (G_OBJECT (window), "action-invoked",
+                          G_CALLBACK(gooroom_notify_daemon_window_action_invoked), xndaemon);
+		g_signal_connect (G_OBJECT (window), "closed",
+                          G_CALLBACK (gooroom_notify_daemon_window_closed), xndaemon);
+
+		if (xndaemon->use_overlay) {
+			/* drawn by the overlay, the window itself is never mapped */
+			g_object_set_data (G_OBJECT(window), "--notify-overlay", GINT_TO_POINTER (TRUE));
+		} else {
+			g_signal_connect (G_OBJECT (window), "size-allocate",
+                              G_CALLBACK (gooroom_notify_daemon_window_size_allocate), xndaemon);
+
+			gtk_widget_realize (GTK_WIDGET (window));
+
+			g_idle_add ((GSourceFunc)notify_show_window, window);
+		}
+	}
+
+	if (record->icon_data)
+		gooroom_notify_window_set_icon_data (window, record->icon_data);
+	else if (record->icon)
+		gooroom_notify_window_set_icon_name (window, record->icon);
+
+	gooroom_notify_window_set_icon_only (window, record->flags & GOOROOM_NOTIFY_RECORD_ICON_ONLY);
+	gooroom_notify_window_set_do_fadeout (window, xndaemon->do_fadeout, xndaemon->do_slideout);
+	gooroom_notify_window_set_notify_location (window, xndaemon->notify_location);
+
+	if (record->flags & GOOROOM_NOTIFY_RECORD_HAS_VALUE)
+		gooroom_notify_window_set_gauge_value (window, record->value);
+	else
+		gooroom_notify_window_unset_gauge_value (window);
+
+	if (gooroom_notify_daemon_window_is_overlaid (window)) {
+		GtkAllocation allocation = { 0, };
+
+		gooroom_notify_overlay_measure (window, &allocation.width, &allocation.height);
+		gooroom_notify_daemon_window_size_allocate (GTK_WIDGET (window), &allocation, xndaemon);
+	} else {
+		gtk_widget_realize (GTK_WIDGET (window));
+	}
+}
+
+static void
+gooroom_notify_daemon_queue_record (GooroomNotifyDaemon *xndaemon,
+                                    GooroomNotifyRecord *record)
+{
+	GooroomNotifyRecord *oldest;
+
+	/* kept without a window until "Do not disturb" ends, an update keeps
+	 * its place in line */
+	record->state = GOOROOM_NOTIFY_RECORD_QUEUED;
+
+	if (record->deferred_size)
+		xndaemon->deferred_bytes -= record->deferred_size;
+	else
+		g_queue_push_tail (xndaemon->deferred, record);
+
+	record->deferred_size = gooroom_notify_record_get_size (record);
+	xndaemon->deferred_bytes += record->deferred_size;
+
+	while ((oldest = g_queue_peek_head (xndaemon->deferred)) != record &&
+	       (g_queue_get_length (xndaemon->deferred) > DEFERRED_MAX_RECORDS ||
+	        xndaemon->deferred_bytes > DEFERRED_MAX_BYTES)) {
+		gooroom_notify_daemon_record_closed (xndaemon, oldest, GOOROOM_NOTIFY_CLOSE_REASON_EXPIRED);
+	}
+}
+
+static void
+gooroom_notify_daemon_release_next (gpointer user_data)
+{
+	GooroomNotifyDaemon *xndaemon = user_data;
+	GooroomNotifyRecord *record;
+
+	xndaemon->release_timer_id = 0;
+
+	record = g_queue_peek_head (xndaemon->deferred);
+	if (!record || xndaemon->do_not_disturb)
+		return;
+
+	gooroom_notify_daemon_show_record (xndaemon, record);
+	gooroom_notify_daemon_record_changed (xndaemon, record);
+
+	if (!g_queue_is_empty (xndaemon->deferred))
+		xndaemon->release_timer_id = gooroom_notify_timer_add (RELEASE_INTERVAL,
+		                                                       gooroom_notify_daemon_release_next,
+		                                                       xndaemon);
+}
+
+typedef struct
+{
+	GooroomNotifyRecord *record;
+	/* the first one folded into it, and the summaries of all of them */
+	GooroomNotifyRecord *first;
+	GPtrArray           *summaries;
+} GooroomNotifyDigest;
+
+static void
+gooroom_notify_digest_free (gpointer data)
+{
+	GooroomNotifyDigest *digest = data;
+
+	g_ptr_array_free (digest->summaries, TRUE);
+	g_free (digest);
+}
+
+static void
+gooroom_notify_daemon_fill_digest (GooroomNotifyDaemon *xndaemon,
+                                   GooroomNotifyDigest *digest)
+{
+	GooroomNotifyRecord *record = digest->record;
+	GString *body = g_string_new (NULL);
+	gchar *summary, *escaped;
+	guint i;
+
+	/* the latest ones, as many as the body has lines for */
+	i = digest->summaries->len > BODY_LINES ? digest->summaries->len - BODY_LINES : 0;
+	for (; i < digest->summaries->len; i++) {
+		escaped = g_markup_escape_text (g_ptr_array_index (digest->summaries, i), -1);
+		if (body->len)
+			g_string_append_c (body, '\n');
+		g_string_append (body, escaped);
+		g_free (escaped);
+	}
+
+	summary = g_strdup_printf (ngettext ("%s: %u notification", "%s: %u notifications",
+	                                     digest->summaries->len),
+	                           digest->first->app_name, digest->summaries->len);
+
+	gooroom_notify_record_set_strings (record, digest->first->app_name, summary, body->str,
+	                                   digest->first->icon, NULL);
+	gooroom_notify_record_set_icon_data (record, digest->first->icon_data);
+	record->expire_timeout = xndaemon->expire_timeout;
+	record->urgency = URGENCY_NORMAL;
+
+	g_free (summary);
+	g_string_free (body, TRUE);
+}
+
+static void
+gooroom_notify_daemon_release_deferred (GooroomNotifyDaemon *xndaemon)
+{
+	GooroomNotifyRecord *record;
+	GooroomNotifyDigest *digest;
+	GHashTable *counts, *digests;
+	GHashTableIter iter;
+	GQueue *stream;
+	GList *folded = NULL, *l;
+	guint count;
+
+	if (xndaemon->release_timer_id || g_queue_is_empty (xndaemon->deferred))
+		return;
+
+	/* app names are interned, so they are counted by pointer */
+	counts = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (l = xndaemon->deferred->head; l; l = l->next) {
+		record = l->data;
+		if (record->app_name) {
+			count = GPOINTER_TO_UINT (g_hash_table_lookup (counts, record->app_name));
+			g_hash_table_insert (counts, (gpointer)record->app_name, GUINT_TO_POINTER (count + 1));
+		}
+	}
+
+	/* a digest takes the place of the first record it folds */
+	digests = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, gooroom_notify_digest_free);
+	stream = g_queue_new ();
+
+	while ((record = g_queue_pop_head (xndaemon->deferred))) {
+		if (!record->app_name ||
+		    GPOINTER_TO_UINT (g_hash_table_lookup (counts, record->app_name)) <= DIGEST_THRESHOLD) {
+			g_queue_push_tail (stream, record);
+			continue;
+		}
+
+		digest = g_hash_table_lookup (digests, record->app_name);
+		if (!digest) {
+			digest = g_new0 (GooroomNotifyDigest, 1);
+			digest->first = record;
+			digest->summaries = g_ptr_array_new ();
+			digest->record = gooroom_notify_record_new (gooroom_notify_daemon_generate_id (xndaemon));
+			digest->record->owner = xndaemon;
+			gooroom_notify_id_index_insert (xndaemon->active_notifications, digest->record->id, digest->record);
+			g_hash_table_insert (digests, (gpointer)record->app_name, digest);
+			g_queue_push_tail (stream, digest->record);
+		}
+
+		g_ptr_array_add (digest->summaries, (gpointer)gooroom_notify_record_get_summary (record));
+		xndaemon->deferred_bytes -= record->deferred_size;
+		record->deferred_size = 0;
+		folded = g_list_prepend (folded, record);
+	}
+
+	g_queue_free (xndaemon->deferred);
+	xndaemon->deferred = stream;
+
+	g_hash_table_iter_init (&iter, digests);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&digest)) {
+		gooroom_notify_daemon_fill_digest (xndaemon, digest);
+		digest->record->state = GOOROOM_NOTIFY_RECORD_QUEUED;
+		digest->record->deferred_size = gooroom_notify_record_get_size (digest->record);
+		xndaemon->deferred_bytes += digest->record->deferred_size;
+	}
+
+	/* the summaries above belong to the folded records */
+	g_hash_table_destroy (digests);
+	g_hash_table_destroy (counts);
+
+	folded = g_list_reverse (folded);
+	for (l = folded; l; l = l->next)
+		gooroom_notify_daemon_record_closed (xndaemon, l->data, GOOROOM_NOTIFY_CLOSE_REASON_UNKNOWN);
+	g_list_free (folded);
+
+	gooroom_notify_daemon_record_changed (xndaemon, NULL);
+
+	/* one at a time, never a burst of windows */
+	xndaemon->release_timer_id = gooroom_notify_timer_add (0, gooroom_notify_daemon_release_next, xndaemon);
+}
+
+static gboolean
+notify_hint_is_image (const gchar *key)
+{
+	/* icon_data is the name image-data had in older versions of the spec */
+	return g_str_equal (key, "image-data") || g_str_equal (key, "image_data") ||
+	       g_str_equal (key, "image-path") || g_str_equal (key, "image_path") ||
+	       g_str_equal (key, "icon-data") || g_str_equal (key, "icon_data");
+}
+
 static gboolean
 notify_notify (GooroomNotifyGBus *skeleton,
                GDBusMethodInvocation   *invocation,
@@ -995,20 +1720,57 @@ notify_notify (GooroomNotifyGBus *skeleton,
                gint expire_timeout,
                GooroomNotifyDaemon *xndaemon)
 {
-	GooroomNotifyWindow *window;
-	GdkPixbuf *pix = NULL;
+	GooroomNotifyRecord *record = NULL;
 	GVariant *image_data = NULL;
 	GVariant *icon_data = NULL;
+	GVariant *icon_variant = NULL;
 	const gchar *image_path = NULL;
+	const gchar *icon = NULL;
 	gchar *desktop_id = NULL;
-	gchar *new_app_name;
+	gchar *desktop_icon = NULL;
+	gchar *capped_summary, *capped_body;
+	guint8 urgency = URGENCY_NORMAL;
 	gint value_hint = 0;
 	gboolean value_hint_set = FALSE;
 	gboolean x_canonical = FALSE;
 	gboolean transient = FALSE;
 	GVariant *item;
 	GVariantIter iter;
-	guint OUT_id = gooroom_notify_daemon_generate_id(xndaemon);
+	guint OUT_id;
+	const GooroomNotifyPolicy *policy = gooroom_notify_policy_lookup (app_name);
+	gboolean strip_images = FALSE;
+
+	if (xndaemon->handed_over) {
+		/* the ids belong to the successor now */
+		gooroom_notify_daemon_forward_call (xndaemon, invocation);
+		return TRUE;
+	}
+
+	if (policy && (policy->flags & GOOROOM_NOTIFY_POLICY_MUTE)) {
+		/* muted applications are answered before anything is looked at,
+		 * but what they shared before being muted is taken down */
+		if (replaces_id)
+			record = gooroom_notify_id_index_lookup (xndaemon->active_notifications, replaces_id);
+
+		if (!record) {
+			OUT_id = gooroom_notify_daemon_generate_id (xndaemon);
+			gooroom_notify_gbus_complete_notify (skeleton, invocation, OUT_id);
+			gooroom_notify_gbus_emit_notification_closed (GOOROOM_NOTIFY_GBUS (xndaemon), OUT_id,
+			                                              GOOROOM_NOTIFY_CLOSE_REASON_UNKNOWN);
+			return TRUE;
+		}
+
+		gooroom_notify_gbus_complete_notify (skeleton, invocation, replaces_id);
+		if (record->window)
+			gooroom_notify_window_closed (GOOROOM_NOTIFY_WINDOW (record->window),
+			                              GOOROOM_NOTIFY_CLOSE_REASON_UNKNOWN);
+		else
+			gooroom_notify_daemon_record_closed (xndaemon, record, GOOROOM_NOTIFY_CLOSE_REASON_UNKNOWN);
+		return TRUE;
+	}
+
+	if (policy)
+		strip_images = (policy->flags & GOOROOM_NOTIFY_POLICY_STRIP_IMAGES) != 0;
 
 	g_variant_iter_init (&iter, hints);
 
@@ -1018,12 +1780,12 @@ notify_notify (GooroomNotifyGBus *skeleton,
 
 		g_variant_get (item, "{sv}", &key, &value);
 
-		if (g_strcmp0 (key, "urgency") == 0) {
-			if (g_variant_is_of_type (value, G_VARIANT_TYPE_BYTE) &&
-                g_variant_get_byte (value) == URGENCY_CRITICAL) {
-				/* don't expire urgent notifications */
-				expire_timeout = 0;
-			}
+		if (!gooroom_notify_policy_allows_hint (policy, key) ||
+		    (strip_images && notify_hint_is_image (key))) {
+			g_variant_unref (value);
+		} else if (g_strcmp0 (key, "urgency") == 0) {
+			if (g_variant_is_of_type (value, G_VARIANT_TYPE_BYTE))
+				urgency = g_variant_get_byte (value);
 			g_variant_unref (value);
 		} else if ((g_strcmp0 (key, "image-data") == 0) ||
                    (g_strcmp0 (key, "image_data") == 0)) {
@@ -1066,89 +1828,87 @@ notify_notify (GooroomNotifyGBus *skeleton,
 		g_variant_unref (item);
 	}
 
-	if (desktop_id)
-		new_app_name = g_strdup (desktop_id);
-	else
-		new_app_name = g_strdup (app_name);
+	if (policy && (policy->flags & GOOROOM_NOTIFY_POLICY_URGENCY))
+		urgency = policy->urgency;
 
-	if(expire_timeout == -1)
-		expire_timeout = xndaemon->expire_timeout;
-
-	/* Don't show notification bubbles in the "Do not disturb" mode or if the
-	   application has been muted by the user. Exceptions are "urgent"
-	   notifications which do not expire. */
-	if (expire_timeout != 0) {
-		if (xndaemon->do_not_disturb == TRUE) {
-			gooroom_notify_gbus_complete_notify (skeleton, invocation, OUT_id);
-			if (image_data)
-				g_variant_unref (image_data);
-			if (desktop_id)
-				g_free (desktop_id);
-			return TRUE;
-		}
+	if (urgency == URGENCY_CRITICAL) {
+		/* don't expire urgent notifications */
+		expire_timeout = 0;
 	}
 
-	if (replaces_id &&
-        (window = g_tree_lookup (xndaemon->active_notifications, GUINT_TO_POINTER (replaces_id)))) {
-		gooroom_notify_window_set_summary (window, summary);
-		gooroom_notify_window_set_body (window, body);
-		gooroom_notify_window_set_actions (window, actions);
-		gooroom_notify_window_set_expire_timeout (window, expire_timeout);
-		gooroom_notify_window_set_opacity (window, xndaemon->initial_opacity);
-
-		OUT_id = replaces_id;
-	} else {
-		window = GOOROOM_NOTIFY_WINDOW (gooroom_notify_window_new_with_actions (summary, body, app_icon, expire_timeout, actions));
-		gooroom_notify_window_set_opacity (window, xndaemon->initial_opacity);
-
-		g_object_set_data (G_OBJECT(window), "--notify-id", GUINT_TO_POINTER (OUT_id));
+	if(expire_timeout == -1)
+		expire_timeout = xndaemon->expire_timeout;
 
-		g_tree_insert (xndaemon->active_notifications, GUINT_TO_POINTER (OUT_id), window);
+	if (policy && (policy->flags & GOOROOM_NOTIFY_POLICY_MAX_TIMEOUT) &&
+	    (expire_timeout <= 0 || expire_timeout > policy->max_timeout))
+		expire_timeout = policy->max_timeout;
 
-		g_signal_connect (G_OBJECT (window), "action-invoked",
-                          G_CALLBACK(gooroom_notify_daemon_window_action_invoked), xndaemon);
-		g_signal_connect (G_OBJECT (window), "closed",
-                          G_CALLBACK (gooroom_notify_daemon_window_closed), xndaemon);
-		g_signal_connect (G_OBJECT (window), "size-allocate",
-                          G_CALLBACK (gooroom_notify_daemon_window_size_allocate), xndaemon);
+	capped_summary = notify_text_truncate (summary, gooroom_notify_daemon_get_text_budget (SUMMARY_LINES));
+	if (capped_summary)
+		summary = capped_summary;
 
-		gtk_widget_realize (GTK_WIDGET (window));
-
-		g_idle_add ((GSourceFunc)notify_show_window, window);
-	}
+	/* sanitizing and capping the body is one pass over it */
+	capped_body = notify_markup_sanitize (body, gooroom_notify_daemon_get_text_budget (BODY_LINES), TRUE);
+	if (capped_body)
+		body = capped_body;
 
 	if (image_data) {
-		pix = notify_pixbuf_from_image_data (image_data);
-		if (pix) {
-			gooroom_notify_window_set_icon_pixbuf (window, pix);
-			g_object_unref (G_OBJECT(pix));
-		}
+		icon_variant = image_data;
 	} else if (image_path) {
-		gooroom_notify_window_set_icon_name (window, image_path);
+		icon = image_path;
 	} else if (app_icon && (g_strcmp0 (app_icon, "") != 0)) {
-		gooroom_notify_window_set_icon_name (window, app_icon);
+		icon = app_icon;
 	} else if (icon_data) {
-		pix = notify_pixbuf_from_image_data (icon_data);
-		if (pix) {
-			gooroom_notify_window_set_icon_pixbuf (window, pix);
-			g_object_unref (G_OBJECT(pix));
-		}
+		icon_variant = icon_data;
 	} else if (desktop_id) {
-		gchar *icon = notify_icon_name_from_desktop_id (desktop_id);
-		gooroom_notify_window_set_icon_name (window, icon);
-		g_free (icon);
+		desktop_icon = notify_icon_name_from_desktop_id (desktop_id);
+		icon = desktop_icon;
 	}
 
-	gooroom_notify_window_set_icon_only (window, x_canonical);
-	gooroom_notify_window_set_do_fadeout (window, xndaemon->do_fadeout, xndaemon->do_slideout);
-	gooroom_notify_window_set_notify_location (window, xndaemon->notify_location);
+	if (replaces_id)
+		record = gooroom_notify_id_index_lookup (xndaemon->active_notifications, replaces_id);
+
+	if (record) {
+		OUT_id = replaces_id;
+		record->timestamp = g_get_real_time ();
 
-	if (value_hint_set)
-		gooroom_notify_window_set_gauge_value (window, value_hint);
+		/* an update without an icon keeps the one it had */
+		if (!icon && !icon_variant) {
+			icon = record->icon;
+			icon_variant = record->icon_data;
+		}
+	} else {
+		OUT_id = gooroom_notify_daemon_generate_id (xndaemon);
+		record = gooroom_notify_record_new (OUT_id);
+		record->owner = xndaemon;
+		gooroom_notify_id_index_insert (xndaemon->active_notifications, OUT_id, record);
+	}
+
+	gooroom_notify_record_set_icon_data (record, icon_variant);
+	gooroom_notify_record_set_strings (record,
+	                                   desktop_id ? desktop_id : app_name,
+	                                   summary,
+	                                   body,
+	                                   icon_variant ? NULL : icon,
+	                                   g_dbus_method_invocation_get_sender (invocation));
+	gooroom_notify_record_set_actions (record, actions);
+
+	record->expire_timeout = expire_timeout;
+	record->urgency = urgency;
+	record->value = value_hint;
+	record->flags = (x_canonical ? GOOROOM_NOTIFY_RECORD_ICON_ONLY : 0) |
+	                (transient ? GOOROOM_NOTIFY_RECORD_TRANSIENT : 0) |
+	                (value_hint_set ? GOOROOM_NOTIFY_RECORD_HAS_VALUE : 0);
+
+	/* Don't show notification bubbles in the "Do not disturb" mode or if the
+	   application has been muted by the user. Exceptions are "urgent"
+	   notifications which do not expire. */
+	if (expire_timeout != 0 && xndaemon->do_not_disturb && !record->window)
+		gooroom_notify_daemon_queue_record (xndaemon, record);
 	else
-		gooroom_notify_window_unset_gauge_value (window);
+		gooroom_notify_daemon_show_record (xndaemon, record);
 
-	gtk_widget_realize (GTK_WIDGET (window));
+	gooroom_notify_daemon_record_changed (xndaemon, record);
 
 	gooroom_notify_gbus_complete_notify (skeleton, invocation, OUT_id);
 
@@ -1159,6 +1919,10 @@ notify_notify (GooroomNotifyGBus *skeleton,
 	if (desktop_id)
 		g_free (desktop_id);
 
+	g_free (desktop_icon);
+	g_free (capped_summary);
+	g_free (capped_body);
+
 	return TRUE;
 }
 
@@ -1169,10 +1933,21 @@ notify_close_notification (GooroomNotifyGBus     *skeleton,
                            guint                  id,
                            GooroomNotifyDaemon   *xndaemon)
 {
-	GooroomNotifyWindow *window = g_tree_lookup (xndaemon->active_notifications, GUINT_TO_POINTER (id));
+	GooroomNotifyRecord *record;
 
-	if (window)
-		gooroom_notify_window_closed (window, GOOROOM_NOTIFY_CLOSE_REASON_CLIENT);
+	if (xndaemon->handed_over) {
+		gooroom_notify_daemon_forward_call (xndaemon, invocation);
+		return TRUE;
+	}
+
+	record = gooroom_notify_id_index_lookup (xndaemon->active_notifications, id);
+
+	if (record && record->window) {
+		gooroom_notify_window_closed (GOOROOM_NOTIFY_WINDOW (record->window),
+		                              GOOROOM_NOTIFY_CLOSE_REASON_CLIENT);
+	} else if (record) {
+		gooroom_notify_daemon_record_closed (xndaemon, record, GOOROOM_NOTIFY_CLOSE_REASON_CLIENT);
+	}
 
 	gooroom_notify_gbus_complete_close_notification (skeleton, invocation);
 
@@ -1216,6 +1991,507 @@ notify_quit (GooroomNotifyKrGooroomNotifyd *skeleton,
 	return TRUE;
 }
 
+static gboolean
+notify_get_stats (GooroomNotifyKrGooroomNotifyd *skeleton,
+                  GDBusMethodInvocation         *invocation,
+                  GooroomNotifyDaemon           *xndaemon)
+{
+	GVariantBuilder builder;
+	guint64 hits, misses, dedup_bytes, wakeups;
+	gsize bytes;
+	guint entries;
+	gint64 now;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_VARDICT);
+
+	gooroom_notify_icon_cache_get_stats (&hits, &misses, &dedup_bytes, &bytes, &entries);
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-hits", g_variant_new_uint64 (hits));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-misses", g_variant_new_uint64 (misses));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-dedup-bytes", g_variant_new_uint64 (dedup_bytes));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-bytes", g_variant_new_uint64 (bytes));
+	g_variant_builder_add (&builder, "{sv}", "icon-cache-entries", g_variant_new_uint32 (entries));
+	g_variant_builder_add (&builder, "{sv}", "icon-disk-cache-hits",
+	                       g_variant_new_uint32 (gooroom_notify_disk_cache_get_hits ()));
+	g_variant_builder_add (&builder, "{sv}", "interned-strings",
+	                       g_variant_new_uint32 (gooroom_notify_intern_get_size ()));
+	g_variant_builder_add (&builder, "{sv}", "deferred-notifications",
+	                       g_variant_new_uint32 (g_queue_get_length (xndaemon->deferred)));
+	g_variant_builder_add (&builder, "{sv}", "deferred-bytes",
+	                       g_variant_new_uint64 (xndaemon->deferred_bytes));
+
+	/* expiration timer wakeups and animation frames; the rate covers the
+	 * time since the previous call */
+	now = g_get_monotonic_time ();
+	wakeups = gooroom_notify_timer_get_wakeups () + gooroom_notify_animation_get_ticks ();
+	g_variant_builder_add (&builder, "{sv}", "wakeups", g_variant_new_uint64 (wakeups));
+	g_variant_builder_add (&builder, "{sv}", "wakeups-per-second",
+	                       g_variant_new_double (now > xndaemon->stats_time
+	                                             ? (gdouble)(wakeups - xndaemon->stats_wakeups) * G_USEC_PER_SEC / (now - xndaemon->stats_time)
+	                                             : 0.0));
+	xndaemon->stats_time = now;
+	xndaemon->stats_wakeups = wakeups;
+
+	gooroom_notify_kr_gooroom_notifyd_complete_get_stats (skeleton, invocation,
+	                                                      g_variant_builder_end (&builder));
+
+	return TRUE;
+}
+
+static GVariant *
+notify_record_to_variant (GooroomNotifyRecord *record)
+{
+	GVariantBuilder hints;
+
+	g_variant_builder_init (&hints, G_VARIANT_TYPE_VARDICT);
+
+	g_variant_builder_add (&hints, "{sv}", "urgency", g_variant_new_byte (record->urgency));
+	g_variant_builder_add (&hints, "{sv}", "state",
+	                       g_variant_new_string (record->state == GOOROOM_NOTIFY_RECORD_SHOWN ? "shown" : "queued"));
+	g_variant_builder_add (&hints, "{sv}", "expire-timeout", g_variant_new_int32 (record->expire_timeout));
+	if (record->icon)
+		g_variant_builder_add (&hints, "{sv}", "icon", g_variant_new_string (record->icon));
+	if (record->sender)
+		g_variant_builder_add (&hints, "{sv}", "sender", g_variant_new_string (record->sender));
+	if (record->actions)
+		g_variant_builder_add (&hints, "{sv}", "actions",
+		                       g_variant_new_strv ((const gchar * const *)record->actions, -1));
+	if (record->flags & GOOROOM_NOTIFY_RECORD_HAS_VALUE)
+		g_variant_builder_add (&hints, "{sv}", "value", g_variant_new_int32 (record->value));
+	if (record->flags & GOOROOM_NOTIFY_RECORD_TRANSIENT)
+		g_variant_builder_add (&hints, "{sv}", "transient", g_variant_new_boolean (TRUE));
+	if (record->flags & GOOROOM_NOTIFY_RECORD_ICON_ONLY)
+		g_variant_builder_add (&hints, "{sv}", "x-canonical-private-icon-only", g_variant_new_boolean (TRUE));
+
+	return g_variant_new ("(usss@a{sv}x)",
+	                      record->id,
+	                      record->app_name ? record->app_name : "",
+	                      gooroom_notify_record_get_summary (record),
+	                      gooroom_notify_record_get_body (record),
+	                      g_variant_builder_end (&hints),
+	                      record->timestamp);
+}
+
+static void
+notify_add_record_snapshot (guint32  id,
+                            gpointer value,
+                            gpointer user_data)
+{
+	GooroomNotifyRecord *record = value;
+	GVariantBuilder *builder = user_data;
+
+	/* only what changed since the last call is serialized again */
+	if (!record->snapshot)
+		record->snapshot = g_variant_ref_sink (notify_record_to_variant (record));
+
+	g_variant_builder_add_value (builder, record->snapshot);
+}
+
+static gboolean
+notify_get_active_notifications (GooroomNotifyKrGooroomNotifyd *skeleton,
+                                 GDBusMethodInvocation         *invocation,
+                                 GooroomNotifyDaemon           *xndaemon)
+{
+	if (!xndaemon->snapshot) {
+		GVariantBuilder builder;
+
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(usssa{sv}x)"));
+		gooroom_notify_id_index_foreach (xndaemon->active_notifications,
+		                                 notify_add_record_snapshot,
+		                                 &builder);
+		xndaemon->snapshot = g_variant_ref_sink (g_variant_builder_end (&builder));
+	}
+
+	gooroom_notify_kr_gooroom_notifyd_complete_get_active_notifications (skeleton, invocation,
+	                                                                      xndaemon->snapshot);
+
+	return TRUE;
+}
+
+/* id, app name, summary, body, icon, sender, actions, icon data and value,
+ * remaining timeout, urgency, flags, state and timestamp */
+#define TRANSFER_ENTRY_TYPE "(usssssasa{sv}iyyyx)"
+
+static void
+notify_add_record_state (guint32  id,
+                         gpointer value,
+                         gpointer user_data)
+{
+	GooroomNotifyRecord *record = value;
+	GVariantBuilder *builder = user_data;
+	GVariantBuilder extra;
+	gint remaining;
+
+	/* a queued record has no timer, its time only starts once it is shown */
+	if (record->window)
+		remaining = gooroom_notify_window_get_remaining_timeout (GOOROOM_NOTIFY_WINDOW (record->window));
+	else
+		remaining = record->expire_timeout;
+
+	g_variant_builder_init (&extra, G_VARIANT_TYPE_VARDICT);
+	if (record->icon_data)
+		g_variant_builder_add (&extra, "{sv}", "icon-data", record->icon_data);
+	if (record->flags & GOOROOM_NOTIFY_RECORD_HAS_VALUE)
+		g_variant_builder_add (&extra, "{sv}", "value", g_variant_new_int32 (record->value));
+
+	g_variant_builder_add (builder, "(usssss@asa{sv}iyyyx)",
+	                       record->id,
+	                       record->app_name ? record->app_name : "",
+	                       gooroom_notify_record_get_summary (record),
+	                       gooroom_notify_record_get_body (record),
+	                       record->icon ? record->icon : "",
+	                       record->sender ? record->sender : "",
+	                       g_variant_new_strv ((const gchar * const *)record->actions,
+	                                           record->actions ? -1 : 0),
+	                       &extra,
+	                       remaining,
+	                       record->urgency,
+	                       record->flags,
+	                       record->state,
+	                       record->timestamp);
+}
+
+static void
+gooroom_notify_daemon_set_window_visible (guint32  id,
+                                          gpointer value,
+                                          gpointer user_data)
+{
+	GooroomNotifyRecord *record = value;
+	gboolean visible = GPOINTER_TO_INT (user_data);
+
+	if (!record->window ||
+	    gooroom_notify_daemon_window_is_overlaid (GOOROOM_NOTIFY_WINDOW (record->window)))
+		return;
+
+	if (visible) {
+		gtk_widget_show (record->window);
+	} else {
+		/* it may not be on screen yet */
+		g_idle_remove_by_data (record->window);
+		gtk_widget_hide (record->window);
+	}
+}
+
+static void
+gooroom_notify_daemon_set_windows_visible (GooroomNotifyDaemon *xndaemon,
+                                           gboolean             visible)
+{
+	gint i, nmonitor;
+
+	gooroom_notify_id_index_foreach (xndaemon->active_notifications,
+	                                 gooroom_notify_daemon_set_window_visible,
+	                                 GINT_TO_POINTER (visible));
+
+	if (!xndaemon->overlays)
+		return;
+
+	/* an overlay is only up while it has notifications */
+	nmonitor = GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (gdk_screen_get_default ()), XND_N_MONITORS));
+	for (i = 0; i < nmonitor; i++) {
+		GtkWidget *overlay = xndaemon->overlays[i];
+
+		if (!overlay)
+			continue;
+
+		if (!visible) {
+			g_object_set_data (G_OBJECT (overlay), "--notify-handover-hidden",
+			                   GINT_TO_POINTER (gtk_widget_get_visible (overlay)));
+			gtk_widget_hide (overlay);
+		} else if (g_object_get_data (G_OBJECT (overlay), "--notify-handover-hidden")) {
+			g_object_set_data (G_OBJECT (overlay), "--notify-handover-hidden", NULL);
+			gtk_widget_show (overlay);
+		}
+	}
+}
+
+static gboolean
+gooroom_notify_daemon_handover_done (gpointer user_data)
+{
+	GooroomNotifyDaemon *xndaemon = user_data;
+
+	/* anything sent to the name before it moved has arrived by now */
+	xndaemon->handover_source_id = 0;
+	daemon_quit (xndaemon);
+
+	return FALSE;
+}
+
+static void
+notify_forward_call_done (GObject      *source_object,
+                          GAsyncResult *res,
+                          gpointer      user_data)
+{
+	GDBusMethodInvocation *invocation = user_data;
+	GError *error = NULL;
+	GVariant *ret;
+
+	ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, &error);
+	if (ret) {
+		g_dbus_method_invocation_return_value (invocation, ret);
+		g_variant_unref (ret);
+	} else {
+		g_dbus_method_invocation_take_error (invocation, error);
+	}
+}
+
+/* The successor answers for this instance; it sees this one as the
+ * sender of the call. */
+static void
+gooroom_notify_daemon_forward_call (GooroomNotifyDaemon   *xndaemon,
+                                    GDBusMethodInvocation *invocation)
+{
+	g_dbus_connection_call (g_dbus_method_invocation_get_connection (invocation),
+	                        xndaemon->successor,
+	                        g_dbus_method_invocation_get_object_path (invocation),
+	                        g_dbus_method_invocation_get_interface_name (invocation),
+	                        g_dbus_method_invocation_get_method_name (invocation),
+	                        g_dbus_method_invocation_get_parameters (invocation),
+	                        NULL,
+	                        G_DBUS_CALL_FLAGS_NO_AUTO_START,
+	                        -1,
+	                        NULL,
+	                        notify_forward_call_done,
+	                        invocation);
+}
+
+/* a method call that is answered after its handler has returned */
+typedef struct
+{
+	GooroomNotifyDaemon   *xndaemon;
+	GDBusMethodInvocation *invocation;
+} GooroomNotifyPendingCall;
+
+static GooroomNotifyPendingCall *
+gooroom_notify_pending_call_new (GooroomNotifyDaemon   *xndaemon,
+                                 GDBusMethodInvocation *invocation)
+{
+	GooroomNotifyPendingCall *call = g_new (GooroomNotifyPendingCall, 1);
+
+	call->xndaemon = g_object_ref (xndaemon);
+	call->invocation = invocation;
+
+	return call;
+}
+
+static void
+gooroom_notify_pending_call_free (GooroomNotifyPendingCall *call)
+{
+	g_object_unref (call->xndaemon);
+	g_free (call);
+}
+
+static void
+notify_transfer_state_checked (GObject      *source_object,
+                               GAsyncResult *res,
+                               gpointer      user_data)
+{
+	GooroomNotifyPendingCall *call = user_data;
+	GooroomNotifyDaemon *xndaemon = call->xndaemon;
+	GDBusMethodInvocation *invocation = call->invocation;
+	GVariantBuilder state, entries;
+	GVariant *ret;
+	const gchar *sender = g_dbus_method_invocation_get_sender (invocation);
+	const gchar **owners = NULL;
+	gboolean queued = FALSE;
+	guint i;
+
+	ret = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), res, NULL);
+	if (ret) {
+		g_variant_get (ret, "(^a&s)", &owners);
+		/* the first one is this instance */
+		for (i = 1; owners[0] && owners[i] && !queued; i++)
+			queued = g_strcmp0 (owners[i], sender) == 0;
+		g_free (owners);
+		g_variant_unref (ret);
+	}
+
+	if (!queued || xndaemon->handed_over || !xndaemon->bus_name_id) {
+		g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
+		                                       "Only a daemon queued for the name can take the state over");
+		gooroom_notify_pending_call_free (call);
+		return;
+	}
+
+	g_variant_builder_init (&entries, G_VARIANT_TYPE ("a" TRANSFER_ENTRY_TYPE));
+	gooroom_notify_id_index_foreach (xndaemon->active_notifications,
+	                                 notify_add_record_state,
+	                                 &entries);
+
+	g_variant_builder_init (&state, G_VARIANT_TYPE_VARDICT);
+	g_variant_builder_add (&state, "{sv}", "last-id",
+	                       g_variant_new_uint32 (xndaemon->last_notification_id));
+	g_variant_builder_add (&state, "{sv}", "notifications", g_variant_builder_end (&entries));
+
+	gooroom_notify_kr_gooroom_notifyd_complete_transfer_state (xndaemon->gooroom_iface_skeleton,
+	                                                           invocation,
+	                                                           g_variant_builder_end (&state));
+
+	/* The reply goes out before the name is released, so the successor
+	 * has the notifications before any call can reach it. They live on
+	 * there; leaving them here as well would show them twice. */
+	xndaemon->handed_over = TRUE;
+	xndaemon->successor = g_strdup (sender);
+	g_bus_unown_name (xndaemon->bus_name_id);
+	xndaemon->bus_name_id = 0;
+
+	gooroom_notify_daemon_update_power_state (xndaemon);
+	gooroom_notify_daemon_set_windows_visible (xndaemon, FALSE);
+	xndaemon->handover_source_id = g_timeout_add (HANDOVER_TIMEOUT,
+	                                              gooroom_notify_daemon_handover_done,
+	                                              xndaemon);
+
+	gooroom_notify_pending_call_free (call);
+}
+
+static gboolean
+notify_transfer_state (GooroomNotifyKrGooroomNotifyd *skeleton,
+                       GDBusMethodInvocation         *invocation,
+                       GooroomNotifyDaemon           *xndaemon)
+{
+	GDBusConnection *connection = g_dbus_method_invocation_get_connection (invocation);
+
+	/* every notification's text goes out, and this instance stops
+	 * serving: only a daemon waiting for the name may ask */
+	if (xndaemon->handed_over ||
+	    g_strcmp0 (g_dbus_method_invocation_get_sender (invocation),
+	               g_dbus_connection_get_unique_name (connection)) == 0) {
+		g_dbus_method_invocation_return_error (invocation, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED,
+		                                       "Only a daemon queued for the name can take the state over");
+		return TRUE;
+	}
+
+	g_dbus_connection_call (connection,
+	                        "org.freedesktop.DBus",
+	                        "/org/freedesktop/DBus",
+	                        "org.freedesktop.DBus",
+	                        "ListQueuedOwners",
+	                        g_variant_new ("(s)", "org.freedesktop.Notifications"),
+	                        G_VARIANT_TYPE ("(as)"),
+	                        G_DBUS_CALL_FLAGS_NONE,
+	                        -1,
+	                        NULL,
+	                        notify_transfer_state_checked,
+	                        gooroom_notify_pending_call_new (xndaemon, invocation));
+
+	return TRUE;
+}
+
+static void
+gooroom_notify_daemon_restore_state (GooroomNotifyDaemon *xndaemon,
+                                     GVariant            *state)
+{
+	GVariantIter *iter;
+	GVariant *actions_v, *extra;
+	const gchar *app_name, *summary, *body, *icon, *sender;
+	guint32 id, last_id;
+	gint remaining;
+	guint8 urgency, flags, record_state;
+	gint64 timestamp;
+
+	if (g_variant_lookup (state, "last-id", "u", &last_id))
+		xndaemon->last_notification_id = MAX (xndaemon->last_notification_id, last_id);
+
+	if (!g_variant_lookup (state, "notifications", "a" TRANSFER_ENTRY_TYPE, &iter))
+		return;
+
+	while (g_variant_iter_next (iter, "(u&s&s&s&s&s@as@a{sv}iyyyx)",
+	                            &id, &app_name, &summary, &body, &icon, &sender,
+	                            &actions_v, &extra,
+	                            &remaining, &urgency, &flags, &record_state, &timestamp)) {
+		GooroomNotifyRecord *record;
+		const gchar **actions;
+		GVariant *icon_data;
+
+		if (id != 0 && !gooroom_notify_id_index_lookup (xndaemon->active_notifications, id)) {
+			record = gooroom_notify_record_new (id);
+			record->owner = xndaemon;
+			gooroom_notify_id_index_insert (xndaemon->active_notifications, id, record);
+
+			gooroom_notify_record_set_strings (record, app_name, summary, body,
+			                                   *icon ? icon : NULL,
+			                                   *sender ? sender : NULL);
+
+			actions = g_variant_get_strv (actions_v, NULL);
+			gooroom_notify_record_set_actions (record, actions);
+			g_free (actions);
+
+			icon_data = g_variant_lookup_value (extra, "icon-data", NULL);
+			if (icon_data) {
+				gooroom_notify_record_set_icon_data (record, icon_data);
+				g_variant_unref (icon_data);
+			}
+			g_variant_lookup (extra, "value", "i", &record->value);
+
+			record->timestamp = timestamp;
+			record->urgency = urgency;
+			record->flags = flags;
+			record->expire_timeout = remaining;
+
+			if (record_state == GOOROOM_NOTIFY_RECORD_QUEUED)
+				gooroom_notify_daemon_queue_record (xndaemon, record);
+			else
+				gooroom_notify_daemon_show_record (xndaemon, record);
+
+			/* ids handed out from here on must not clash */
+			if (id >= xndaemon->last_notification_id)
+				xndaemon->last_notification_id = id + 1;
+		}
+
+		g_variant_unref (actions_v);
+		g_variant_unref (extra);
+	}
+
+	g_variant_iter_free (iter);
+
+	gooroom_notify_daemon_record_changed (xndaemon, NULL);
+
+	if (!xndaemon->do_not_disturb)
+		gooroom_notify_daemon_release_deferred (xndaemon);
+}
+
+static void
+notify_get_history_done (GObject      *source_object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+	GooroomNotifyPendingCall *call = user_data;
+	GVariant *entries;
+	GError *error = NULL;
+
+	entries = gooroom_notify_history_query_finish (result, &error);
+
+	if (entries) {
+		gooroom_notify_kr_gooroom_notifyd_complete_get_history (call->xndaemon->gooroom_iface_skeleton,
+		                                                        call->invocation, entries);
+		g_variant_unref (entries);
+	} else {
+		g_dbus_method_invocation_take_error (call->invocation, error);
+	}
+
+	gooroom_notify_pending_call_free (call);
+}
+
+static gboolean
+notify_get_history (GooroomNotifyKrGooroomNotifyd *skeleton,
+                    GDBusMethodInvocation         *invocation,
+                    guint                          offset,
+                    guint                          limit,
+                    GVariant                      *filter,
+                    GooroomNotifyDaemon           *xndaemon)
+{
+	const gchar *app_name = NULL;
+	gint64 since = 0, until = 0;
+
+	g_variant_lookup (filter, "app-name", "&s", &app_name);
+	g_variant_lookup (filter, "since", "x", &since);
+	g_variant_lookup (filter, "until", "x", &until);
+
+	gooroom_notify_history_query_async (offset, limit, app_name, since, until,
+	                                    notify_get_history_done,
+	                                    gooroom_notify_pending_call_new (xndaemon, invocation));
+
+	return TRUE;
+}
+
 static void
 gooroom_notify_daemon_settings_changed(GSettings *settings,
                                        const gchar *key,
@@ -1239,6 +2515,25 @@ gooroom_notify_daemon_settings_changed(GSettings *settings,
 		xndaemon->primary_monitor = g_settings_get_uint (settings, key);
 	} else if (g_str_equal (key, "do-not-disturb")) {
 		xndaemon->do_not_disturb = g_settings_get_boolean (settings, key);
+		if (!xndaemon->do_not_disturb) {
+			gooroom_notify_daemon_release_deferred (xndaemon);
+		} else if (xndaemon->release_timer_id) {
+			gooroom_notify_timer_cancel (xndaemon->release_timer_id);
+			xndaemon->release_timer_id = 0;
+		}
+	} else if (g_str_equal (key, "use-overlay")) {
+		xndaemon->use_overlay = g_settings_get_boolean (settings, key);
+	} else if (g_str_equal (key, "power-saving")) {
+		xndaemon->power_saving = g_settings_get_boolean (settings, key);
+		gooroom_notify_daemon_update_power_state (xndaemon);
+	} else if (g_str_equal (key, "history-size")) {
+		gooroom_notify_history_set_max_size ((gsize)g_settings_get_uint (settings, key) * 1024);
+	} else if (g_str_equal (key, "icon-cache-size")) {
+		gooroom_notify_icon_cache_set_budget ((gsize)g_settings_get_uint (settings, key) * 1024);
+	} else if (g_str_equal (key, "policy-file")) {
+		gchar *path = g_settings_get_string (settings, key);
+		gooroom_notify_policy_set_file (path);
+		g_free (path);
 	}
 }
 
@@ -1247,6 +2542,7 @@ gooroom_notify_daemon_load_config (GooroomNotifyDaemon *xndaemon,
                                    GError **error)
 {
 	GSettingsSchema *schema = NULL;
+	gchar *policy_file = NULL;
 
 	schema = g_settings_schema_source_lookup (g_settings_schema_source_get_default (), "apps.gooroom-notifyd", TRUE);
 
@@ -1261,6 +2557,9 @@ gooroom_notify_daemon_load_config (GooroomNotifyDaemon *xndaemon,
 	xndaemon->do_slideout = FALSE;
 	xndaemon->primary_monitor = 0;
 	xndaemon->do_not_disturb = FALSE;
+	xndaemon->use_overlay = FALSE;
+	xndaemon->power_saving = FALSE;
+	gooroom_notify_history_set_max_size (GOOROOM_NOTIFY_HISTORY_DEFAULT_SIZE);
 
 	if (xndaemon->settings) {
 		xndaemon->expire_timeout = g_settings_get_int (xndaemon->settings, "expire-timeout");
@@ -1274,12 +2573,23 @@ gooroom_notify_daemon_load_config (GooroomNotifyDaemon *xndaemon,
 		xndaemon->do_slideout = g_settings_get_boolean (xndaemon->settings, "do-slideout");
 		xndaemon->primary_monitor = g_settings_get_uint (xndaemon->settings, "primary-monitor");
 		xndaemon->do_not_disturb = g_settings_get_boolean (xndaemon->settings, "do-not-disturb");
+		xndaemon->use_overlay = g_settings_get_boolean (xndaemon->settings, "use-overlay");
+		xndaemon->power_saving = g_settings_get_boolean (xndaemon->settings, "power-saving");
+		gooroom_notify_history_set_max_size ((gsize)g_settings_get_uint (xndaemon->settings, "history-size") * 1024);
+		gooroom_notify_icon_cache_set_budget ((gsize)g_settings_get_uint (xndaemon->settings, "icon-cache-size") * 1024);
+
+		policy_file = g_settings_get_string (xndaemon->settings, "policy-file");
 
 		g_signal_connect (G_OBJECT (xndaemon->settings), "changed",
 				G_CALLBACK (gooroom_notify_daemon_settings_changed),
 				xndaemon);
 	}
 
+	gooroom_notify_policy_set_file (policy_file);
+	g_free (policy_file);
+
+	gooroom_notify_daemon_update_power_state (xndaemon);
+
 	return TRUE;
 }
 
@@ -0,0 +1,327 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Rendered icons of image files, kept in $XDG_CACHE_HOME/gooroom-notifyd so
+ * the first notifications after a restart do not decode anything. Each icon
+ * is one file: a fixed header, the cache key and then the ARGB32 pixels,
+ * aligned so a mapping of the file can be painted by cairo as it is. The
+ * format is native endian, the cache is never shared between machines.
+ * Files are written to a temporary name and renamed, so a reader never
+ * sees half of one. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "gooroom-notify-disk-cache.h"
+
+#define DISK_CACHE_MAGIC    0x434e4f47  /* "GONC" */
+#define DISK_CACHE_VERSION  2
+#define DISK_CACHE_ALIGN    64
+
+typedef struct
+{
+	guint32 magic;
+	guint32 version;
+	gint32  width;
+	gint32  height;
+	gint32  stride;
+	guint32 key_length;
+	gint64  mtime;       /* in microseconds */
+	gint64  size;
+	gdouble x_scale;
+	gdouble y_scale;
+	guint8  reserved[8];
+} GooroomNotifyDiskCacheHeader;
+
+G_STATIC_ASSERT (sizeof (GooroomNotifyDiskCacheHeader) == DISK_CACHE_ALIGN);
+
+static const cairo_user_data_key_t mapping_key;
+static volatile gint hits = 0;
+
+
+static const gchar *
+gooroom_notify_disk_cache_get_dir (void)
+{
+	static gchar *dir = NULL;
+
+	if (g_once_init_enter (&dir)) {
+		gchar *path = g_build_filename (g_get_user_cache_dir (), "gooroom-notifyd", "icons", NULL);
+
+		g_once_init_leave (&dir, path);
+	}
+
+	return dir;
+}
+
+static gchar *
+gooroom_notify_disk_cache_get_path (const gchar *key)
+{
+	gchar *name, *path;
+
+	name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+	path = g_build_filename (gooroom_notify_disk_cache_get_dir (), name, NULL);
+	g_free (name);
+
+	return path;
+}
+
+static inline gsize
+gooroom_notify_disk_cache_get_pixel_offset (gsize key_length)
+{
+	gsize offset = sizeof (GooroomNotifyDiskCacheHeader) + key_length;
+
+	return (offset + DISK_CACHE_ALIGN - 1) & ~(gsize)(DISK_CACHE_ALIGN - 1);
+}
+
+cairo_surface_t *
+gooroom_notify_disk_cache_lookup (const gchar *key,
+                                  gint64       mtime,
+                                  goffset      size)
+{
+	gchar *path, *contents;
+	gsize length, offset, key_length;
+	GMappedFile *mapped;
+	cairo_surface_t *surface;
+	GooroomNotifyDiskCacheHeader header;
+
+	g_return_val_if_fail (key != NULL, NULL);
+
+	path = gooroom_notify_disk_cache_get_path (key);
+
+	/* read-only like the icon atlas, the surface is only painted from */
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	if (!mapped) {
+		g_free (path);
+		return NULL;
+	}
+
+	contents = g_mapped_file_get_contents (mapped);
+	length = g_mapped_file_get_length (mapped);
+	key_length = strlen (key);
+
+	if (length < sizeof (header))
+		goto invalid;
+
+	memcpy (&header, contents, sizeof (header));
+
+	if (header.magic != DISK_CACHE_MAGIC || header.version != DISK_CACHE_VERSION ||
+	    header.key_length != key_length ||
+	    header.mtime != mtime || header.size != size ||
+	    header.width <= 0 || header.height <= 0 ||
+	    header.stride != cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, header.width))
+		goto invalid;
+
+	offset = gooroom_notify_disk_cache_get_pixel_offset (key_length);
+	if (length != offset + (gsize)header.stride * header.height ||
+	    memcmp (contents + sizeof (header), key, key_length) != 0)
+		goto invalid;
+
+	surface = cairo_image_surface_create_for_data ((guchar *)contents + offset,
+	                                               CAIRO_FORMAT_ARGB32,
+	                                               header.width, header.height,
+	                                               header.stride);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy (surface);
+		goto invalid;
+	}
+
+	cairo_surface_set_device_scale (surface, header.x_scale, header.y_scale);
+	cairo_surface_set_user_data (surface, &mapping_key, mapped,
+	                             (cairo_destroy_func_t)g_mapped_file_unref);
+
+	/* the modification time keeps track of use, see trim () */
+	g_utime (path, NULL);
+	g_free (path);
+
+	g_atomic_int_inc (&hits);
+
+	return surface;
+
+invalid:
+	/* stale or from another version, it is written again after decoding */
+	g_mapped_file_unref (mapped);
+	g_unlink (path);
+	g_free (path);
+
+	return NULL;
+}
+
+void
+gooroom_notify_disk_cache_store (const gchar     *key,
+                                 gint64           mtime,
+                                 goffset          size,
+                                 cairo_surface_t *surface)
+{
+	gchar *path, *contents;
+	gsize length, offset, key_length;
+	GooroomNotifyDiskCacheHeader header;
+	GError *error = NULL;
+	gint y;
+
+	g_return_if_fail (key != NULL && surface != NULL);
+
+	if (cairo_surface_get_type (surface) != CAIRO_SURFACE_TYPE_IMAGE ||
+	    cairo_image_surface_get_format (surface) != CAIRO_FORMAT_ARGB32)
+		return;
+
+	cairo_surface_flush (surface);
+
+	memset (&header, 0, sizeof (header));
+	header.magic = DISK_CACHE_MAGIC;
+	header.version = DISK_CACHE_VERSION;
+	header.width = cairo_image_surface_get_width (surface);
+	header.height = cairo_image_surface_get_height (surface);
+	header.stride = cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, header.width);
+	header.mtime = mtime;
+	header.size = size;
+	cairo_surface_get_device_scale (surface, &header.x_scale, &header.y_scale);
+
+	key_length = strlen (key);
+	header.key_length = key_length;
+
+	offset = gooroom_notify_disk_cache_get_pixel_offset (key_length);
+	length = offset + (gsize)header.stride * header.height;
+
+	contents = g_malloc0 (length);
+	memcpy (contents, &header, sizeof (header));
+	memcpy (contents + sizeof (header), key, key_length);
+
+	/* the surface may have a wider stride than the file */
+	for (y = 0; y < header.height; y++) {
+		memcpy (contents + offset + (gsize)y * header.stride,
+		        cairo_image_surface_get_data (surface) + (gsize)y * cairo_image_surface_get_stride (surface),
+		        header.stride);
+	}
+
+	path = gooroom_notify_disk_cache_get_path (key);
+
+	if (g_mkdir_with_parents (gooroom_notify_disk_cache_get_dir (), 0700) != 0 ||
+	    !g_file_set_contents (path, contents, length, &error)) {
+		g_debug ("Failed to write icon cache file %s: %s", path,
+		         error ? error->message : g_strerror (errno));
+		g_clear_error (&error);
+	}
+
+	g_free (path);
+	g_free (contents);
+}
+
+typedef struct
+{
+	gchar  *path;
+	guint64 mtime;
+	goffset size;
+} GooroomNotifyDiskCacheFile;
+
+static gint
+gooroom_notify_disk_cache_compare_files (gconstpointer a,
+                                         gconstpointer b)
+{
+	const GooroomNotifyDiskCacheFile *fa = *(GooroomNotifyDiskCacheFile * const *)a;
+	const GooroomNotifyDiskCacheFile *fb = *(GooroomNotifyDiskCacheFile * const *)b;
+
+	/* most recently used first */
+	return (fa->mtime < fb->mtime) - (fa->mtime > fb->mtime);
+}
+
+static void
+gooroom_notify_disk_cache_file_free (GooroomNotifyDiskCacheFile *file)
+{
+	g_free (file->path);
+	g_free (file);
+}
+
+static void
+gooroom_notify_disk_cache_trim_thread (GTask        *task,
+                                       gpointer      source_object,
+                                       gpointer      task_data,
+                                       GCancellable *cancellable)
+{
+	GDir *dir;
+	GPtrArray *files;
+	const gchar *name;
+	gsize budget = GPOINTER_TO_SIZE (task_data);
+	gsize total = 0;
+	guint i;
+
+	dir = g_dir_open (gooroom_notify_disk_cache_get_dir (), 0, NULL);
+	if (!dir) {
+		/* nothing cached yet */
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	files = g_ptr_array_new_with_free_func ((GDestroyNotify)gooroom_notify_disk_cache_file_free);
+
+	while ((name = g_dir_read_name (dir))) {
+		GStatBuf st;
+		GooroomNotifyDiskCacheFile *file;
+		gchar *path = g_build_filename (gooroom_notify_disk_cache_get_dir (), name, NULL);
+
+		if (g_stat (path, &st) != 0 || !S_ISREG (st.st_mode)) {
+			g_free (path);
+			continue;
+		}
+
+		file = g_new0 (GooroomNotifyDiskCacheFile, 1);
+		file->path = path;
+		file->mtime = st.st_mtime;
+		file->size = st.st_size;
+		g_ptr_array_add (files, file);
+	}
+
+	g_dir_close (dir);
+
+	g_ptr_array_sort (files, gooroom_notify_disk_cache_compare_files);
+
+	for (i = 0; i < files->len; i++) {
+		GooroomNotifyDiskCacheFile *file = g_ptr_array_index (files, i);
+
+		total += file->size;
+		if (total > budget)
+			g_unlink (file->path);
+	}
+
+	g_ptr_array_unref (files);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+void
+gooroom_notify_disk_cache_trim (gsize budget)
+{
+	GTask *task;
+
+	task = g_task_new (NULL, NULL, NULL, NULL);
+	g_task_set_task_data (task, GSIZE_TO_POINTER (budget), NULL);
+	g_task_run_in_thread (task, gooroom_notify_disk_cache_trim_thread);
+	g_object_unref (task);
+}
+
+guint
+gooroom_notify_disk_cache_get_hits (void)
+{
+	return g_atomic_int_get (&hits);
+}
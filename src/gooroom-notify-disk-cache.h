@@ -0,0 +1,49 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_DISK_CACHE_H__
+#define __GOOROOM_NOTIFY_DISK_CACHE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define GOOROOM_NOTIFY_DISK_CACHE_DEFAULT_BUDGET (16 * 1024 * 1024)
+
+/* Both may be called from any thread. The key has to identify the image
+ * and the size it was rendered at, mtime and size are those of the source
+ * file, mtime in microseconds. A surface from lookup lies on read-only
+ * pages of the cache file: use it as a source only and copy it to draw
+ * into it. */
+cairo_surface_t *gooroom_notify_disk_cache_lookup (const gchar     *key,
+                                                   gint64           mtime,
+                                                   goffset          size);
+void             gooroom_notify_disk_cache_store  (const gchar     *key,
+                                                   gint64           mtime,
+                                                   goffset          size,
+                                                   cairo_surface_t *surface);
+
+/* removes the least recently used files over budget, off the main loop */
+void             gooroom_notify_disk_cache_trim   (gsize            budget);
+
+guint            gooroom_notify_disk_cache_get_hits (void);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_DISK_CACHE_H__ */
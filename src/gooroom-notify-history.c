@@ -0,0 +1,504 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Closed notifications, kept in $XDG_DATA_HOME/gooroom-notifyd/history.
+ * The log file only ever grows: every entry is a serialized GVariant, padded
+ * to 8 bytes so that a mapping of the file can be read in place. Next to it,
+ * the index file has one fixed size entry per log entry, in the order they
+ * were written, which is also the order of their time. Queries map both
+ * files and walk the index backwards, only the entries that are returned
+ * are ever touched in the log.
+ *
+ * Appends are collected on the main thread and written in batches by a
+ * single writer thread. Once the log outgrows its share of the size budget,
+ * the files become the previous generation and a new log is started. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+#include "gooroom-notify-history.h"
+#include "gooroom-notify-timer.h"
+
+#define HISTORY_ALIGN        8
+#define HISTORY_BATCH_SIZE   64
+#define HISTORY_FLUSH_DELAY  (5 * 1000)
+#define HISTORY_MAX_PAGE     500
+
+typedef struct
+{
+	gint64  timestamp;
+	guint64 offset;
+	guint32 size;
+	guint32 app_hash;
+} GooroomNotifyHistoryIndexEntry;
+
+G_STATIC_ASSERT (sizeof (GooroomNotifyHistoryIndexEntry) == 24);
+
+typedef struct
+{
+	GMappedFile *index;
+	GMappedFile *log;
+} GooroomNotifyHistoryGeneration;
+
+typedef struct
+{
+	guint    batch;
+	guint    offset;
+	guint    limit;
+	gchar   *app_name;
+	gint64   since;
+	gint64   until;
+} GooroomNotifyHistoryQuery;
+
+/* the writer and the queries take turns on the files; a query waits for
+ * the batches pushed before it */
+static GMutex       lock;
+static GCond        written_cond;
+static guint        written = 0;
+static gsize        max_size = 0;
+static gint64       last_timestamp = 0;
+
+static guint        pushed = 0;
+static GPtrArray   *pending = NULL;
+static guint        flush_id = 0;
+static GThreadPool *writer = NULL;
+
+
+static const gchar *
+gooroom_notify_history_get_dir (void)
+{
+	static gchar *dir = NULL;
+
+	if (g_once_init_enter (&dir)) {
+		gchar *path = g_build_filename (g_get_user_data_dir (), "gooroom-notifyd", "history", NULL);
+
+		g_once_init_leave (&dir, path);
+	}
+
+	return dir;
+}
+
+static gchar *
+gooroom_notify_history_get_path (const gchar *name,
+                                 guint        generation)
+{
+	gchar *path, *file;
+
+	file = generation ? g_strdup_printf ("%s.%u", name, generation) : g_strdup (name);
+	path = g_build_filename (gooroom_notify_history_get_dir (), file, NULL);
+	g_free (file);
+
+	return path;
+}
+
+static inline guint32
+gooroom_notify_history_hash (const gchar *app_name)
+{
+	return g_str_hash (app_name ? app_name : "");
+}
+
+static gboolean
+gooroom_notify_history_write_all (gint          fd,
+                                  gconstpointer data,
+                                  gsize         length)
+{
+	const guint8 *p = data;
+
+	while (length > 0) {
+		gssize written = write (fd, p, length);
+
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		p += written;
+		length -= written;
+	}
+
+	return TRUE;
+}
+
+static void
+gooroom_notify_history_rotate (void)
+{
+	gchar *log, *index, *old_log, *old_index;
+
+	log = gooroom_notify_history_get_path ("log", 0);
+	index = gooroom_notify_history_get_path ("index", 0);
+	old_log = gooroom_notify_history_get_path ("log", 1);
+	old_index = gooroom_notify_history_get_path ("index", 1);
+
+	/* the index goes first, an index without its log is never read */
+	g_rename (index, old_index);
+	g_rename (log, old_log);
+
+	g_free (log);
+	g_free (index);
+	g_free (old_log);
+	g_free (old_index);
+}
+
+static void
+gooroom_notify_history_write_batch (gpointer data,
+                                    gpointer user_data)
+{
+	GPtrArray *batch = data;
+	GooroomNotifyHistoryIndexEntry *entries;
+	gchar *log_path, *index_path;
+	gint log_fd = -1, index_fd = -1;
+	struct stat st, index_st;
+	guint64 offset;
+	gsize index_size;
+	guint i;
+
+	g_mutex_lock (&lock);
+
+	if (max_size == 0 || g_mkdir_with_parents (gooroom_notify_history_get_dir (), 0700) != 0)
+		goto out;
+
+	log_path = gooroom_notify_history_get_path ("log", 0);
+	index_path = gooroom_notify_history_get_path ("index", 0);
+	log_fd = g_open (log_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	index_fd = g_open (index_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+	g_free (log_path);
+	g_free (index_path);
+
+	if (log_fd < 0 || index_fd < 0 || fstat (log_fd, &st) != 0 || fstat (index_fd, &index_st) != 0)
+		goto out;
+
+	/* queries read the index as an array, a torn entry of an earlier run
+	 * would shift every later one */
+	index_size = index_st.st_size - index_st.st_size % sizeof (GooroomNotifyHistoryIndexEntry);
+	if ((gsize)index_st.st_size != index_size && ftruncate (index_fd, index_size) != 0)
+		goto out;
+
+	offset = st.st_size;
+	entries = g_new (GooroomNotifyHistoryIndexEntry, batch->len);
+
+	for (i = 0; i < batch->len; i++) {
+		static const guint8 padding[HISTORY_ALIGN] = { 0, };
+		GVariant *entry = g_ptr_array_index (batch, i);
+		const gchar *app_name;
+		gint64 timestamp;
+		gsize size, pad;
+
+		/* a torn write of an earlier run leaves the offset unaligned */
+		pad = (HISTORY_ALIGN - offset % HISTORY_ALIGN) % HISTORY_ALIGN;
+		size = g_variant_get_size (entry);
+
+		if (!gooroom_notify_history_write_all (log_fd, padding, pad) ||
+		    !gooroom_notify_history_write_all (log_fd, g_variant_get_data (entry), size))
+			break;
+
+		offset += pad;
+		g_variant_get_child (entry, 1, "x", &timestamp);
+		g_variant_get_child (entry, 2, "&s", &app_name);
+
+		/* the index has to stay in order of time, even when the clock
+		 * is set back */
+		last_timestamp = MAX (last_timestamp, timestamp);
+		entries[i].timestamp = last_timestamp;
+		entries[i].offset = offset;
+		entries[i].size = size;
+		entries[i].app_hash = gooroom_notify_history_hash (app_name);
+
+		offset += size;
+	}
+
+	/* the index is written last, its entries point at finished data; a
+	 * failed write is cut off again so that it stays aligned */
+	if (!gooroom_notify_history_write_all (index_fd, entries, i * sizeof (GooroomNotifyHistoryIndexEntry)) &&
+	    ftruncate (index_fd, index_size) != 0)
+		g_warning ("Unable to cut the history index back: %s", g_strerror (errno));
+	g_free (entries);
+
+	if (offset > max_size / 2)
+		gooroom_notify_history_rotate ();
+
+out:
+	if (log_fd >= 0)
+		close (log_fd);
+	if (index_fd >= 0)
+		close (index_fd);
+
+	written++;
+	g_cond_broadcast (&written_cond);
+	g_mutex_unlock (&lock);
+
+	g_ptr_array_unref (batch);
+}
+
+static void
+gooroom_notify_history_flush (void)
+{
+	if (flush_id) {
+		gooroom_notify_timer_cancel (flush_id);
+		flush_id = 0;
+	}
+
+	if (!pending || pending->len == 0)
+		return;
+
+	if (!writer)
+		writer = g_thread_pool_new (gooroom_notify_history_write_batch, NULL, 1, FALSE, NULL);
+
+	g_thread_pool_push (writer, pending, NULL);
+	pending = NULL;
+	pushed++;
+}
+
+static void
+gooroom_notify_history_flush_timeout (gpointer user_data)
+{
+	flush_id = 0;
+	gooroom_notify_history_flush ();
+}
+
+void
+gooroom_notify_history_set_max_size (gsize size)
+{
+	g_mutex_lock (&lock);
+	max_size = size;
+	g_mutex_unlock (&lock);
+}
+
+void
+gooroom_notify_history_append (guint32      id,
+                               gint64       timestamp,
+                               const gchar *app_name,
+                               const gchar *summary,
+                               const gchar *body,
+                               guint        reason)
+{
+	GVariant *entry;
+
+	if (max_size == 0)
+		return;
+
+	entry = g_variant_new (GOOROOM_NOTIFY_HISTORY_ENTRY_TYPE,
+	                       id,
+	                       timestamp,
+	                       app_name ? app_name : "",
+	                       summary ? summary : "",
+	                       body ? body : "",
+	                       reason);
+
+	if (!pending)
+		pending = g_ptr_array_new_with_free_func ((GDestroyNotify)g_variant_unref);
+
+	g_ptr_array_add (pending, g_variant_ref_sink (entry));
+
+	if (pending->len >= HISTORY_BATCH_SIZE)
+		gooroom_notify_history_flush ();
+	else if (!flush_id)
+		flush_id = gooroom_notify_timer_add (HISTORY_FLUSH_DELAY, gooroom_notify_history_flush_timeout, NULL);
+}
+
+void
+gooroom_notify_history_close (void)
+{
+	gooroom_notify_history_flush ();
+
+	if (writer) {
+		g_thread_pool_free (writer, FALSE, TRUE);
+		writer = NULL;
+	}
+}
+
+static void
+gooroom_notify_history_query_free (gpointer data)
+{
+	GooroomNotifyHistoryQuery *query = data;
+
+	g_free (query->app_name);
+	g_free (query);
+}
+
+static GMappedFile *
+gooroom_notify_history_map (const gchar *name,
+                            guint        generation)
+{
+	GMappedFile *mapped;
+	gchar *path;
+
+	path = gooroom_notify_history_get_path (name, generation);
+	mapped = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+
+	return mapped;
+}
+
+static void
+gooroom_notify_history_query_thread (GTask        *task,
+                                     gpointer      source_object,
+                                     gpointer      task_data,
+                                     GCancellable *cancellable)
+{
+	GooroomNotifyHistoryQuery *query = task_data;
+	GooroomNotifyHistoryGeneration generations[2] = { { NULL, }, };
+	GVariantBuilder builder;
+	guint32 app_hash;
+	guint g, skipped = 0, count = 0;
+	gboolean done = FALSE;
+
+	/* a rotation moves the files away, the mappings stay with their data */
+	g_mutex_lock (&lock);
+	while ((gint)(written - query->batch) < 0)
+		g_cond_wait (&written_cond, &lock);
+	for (g = 0; g < G_N_ELEMENTS (generations); g++) {
+		generations[g].index = gooroom_notify_history_map ("index", g);
+		generations[g].log = gooroom_notify_history_map ("log", g);
+	}
+	g_mutex_unlock (&lock);
+
+	app_hash = gooroom_notify_history_hash (query->app_name);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" GOOROOM_NOTIFY_HISTORY_ENTRY_TYPE));
+
+	for (g = 0; g < G_N_ELEMENTS (generations) && !done; g++) {
+		const GooroomNotifyHistoryIndexEntry *entries;
+		GBytes *log_bytes;
+		gsize n, lo, hi;
+
+		if (!generations[g].index || !generations[g].log)
+			continue;
+
+		entries = (gconstpointer)g_mapped_file_get_contents (generations[g].index);
+		n = g_mapped_file_get_length (generations[g].index) / sizeof (GooroomNotifyHistoryIndexEntry);
+		log_bytes = g_mapped_file_get_bytes (generations[g].log);
+
+		/* skip everything after until */
+		lo = 0;
+		hi = n;
+		if (query->until) {
+			while (lo < hi) {
+				gsize mid = lo + (hi - lo) / 2;
+
+				if (entries[mid].timestamp <= query->until)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			n = lo;
+		}
+
+		while (n > 0 && !done) {
+			const GooroomNotifyHistoryIndexEntry *e = &entries[--n];
+			GVariant *entry;
+			GBytes *bytes;
+
+			if (query->since && e->timestamp < query->since) {
+				/* the previous generation is older still */
+				done = TRUE;
+				break;
+			}
+
+			if (query->app_name && e->app_hash != app_hash)
+				continue;
+
+			if (e->offset % HISTORY_ALIGN != 0 ||
+			    e->offset + e->size > g_bytes_get_size (log_bytes))
+				continue;
+
+			bytes = g_bytes_new_from_bytes (log_bytes, e->offset, e->size);
+			entry = g_variant_new_from_bytes (G_VARIANT_TYPE (GOOROOM_NOTIFY_HISTORY_ENTRY_TYPE),
+			                                  bytes, FALSE);
+			g_bytes_unref (bytes);
+
+			if (query->app_name) {
+				const gchar *app_name;
+
+				g_variant_get_child (entry, 2, "&s", &app_name);
+				if (g_strcmp0 (app_name, query->app_name) != 0) {
+					g_variant_unref (g_variant_ref_sink (entry));
+					continue;
+				}
+			}
+
+			if (skipped < query->offset) {
+				skipped++;
+				g_variant_unref (g_variant_ref_sink (entry));
+				continue;
+			}
+
+			g_variant_builder_add_value (&builder, entry);
+			done = (++count == query->limit);
+		}
+
+		g_bytes_unref (log_bytes);
+	}
+
+	for (g = 0; g < G_N_ELEMENTS (generations); g++) {
+		if (generations[g].index)
+			g_mapped_file_unref (generations[g].index);
+		if (generations[g].log)
+			g_mapped_file_unref (generations[g].log);
+	}
+
+	g_task_return_pointer (task, g_variant_ref_sink (g_variant_builder_end (&builder)),
+	                       (GDestroyNotify)g_variant_unref);
+}
+
+void
+gooroom_notify_history_query_async (guint                offset,
+                                    guint                limit,
+                                    const gchar         *app_name,
+                                    gint64               since,
+                                    gint64               until,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+	GooroomNotifyHistoryQuery *query;
+	GTask *task;
+
+	query = g_new0 (GooroomNotifyHistoryQuery, 1);
+	query->offset = offset;
+	query->limit = CLAMP (limit, 1, HISTORY_MAX_PAGE);
+	query->app_name = g_strdup (app_name);
+	query->since = since;
+	query->until = until;
+
+	/* what is still pending shows up in the result */
+	gooroom_notify_history_flush ();
+	query->batch = pushed;
+
+	task = g_task_new (NULL, NULL, callback, user_data);
+	g_task_set_task_data (task, query, gooroom_notify_history_query_free);
+	g_task_run_in_thread (task, gooroom_notify_history_query_thread);
+	g_object_unref (task);
+}
+
+GVariant *
+gooroom_notify_history_query_finish (GAsyncResult  *result,
+                                     GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
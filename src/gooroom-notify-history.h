@@ -0,0 +1,59 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_HISTORY_H__
+#define __GOOROOM_NOTIFY_HISTORY_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* the type of one entry of a query result */
+#define GOOROOM_NOTIFY_HISTORY_ENTRY_TYPE "(uxsssu)"
+
+#define GOOROOM_NOTIFY_HISTORY_DEFAULT_SIZE (8 * 1024 * 1024)
+
+/* the log and its previous generation together stay below max_size,
+ * 0 turns the history off */
+void      gooroom_notify_history_set_max_size (gsize max_size);
+
+void      gooroom_notify_history_append       (guint32      id,
+                                               gint64       timestamp,
+                                               const gchar *app_name,
+                                               const gchar *summary,
+                                               const gchar *body,
+                                               guint        reason);
+
+/* writes out what is still pending and waits for it */
+void      gooroom_notify_history_close        (void);
+
+/* newest first; app_name, since and until are left out with NULL and 0 */
+void      gooroom_notify_history_query_async  (guint                offset,
+                                               guint                limit,
+                                               const gchar         *app_name,
+                                               gint64               since,
+                                               gint64               until,
+                                               GAsyncReadyCallback  callback,
+                                               gpointer             user_data);
+GVariant *gooroom_notify_history_query_finish (GAsyncResult        *result,
+                                               GError             **error);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_HISTORY_H__ */
@@ -0,0 +1,414 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A read-only file of prerendered system icons, built once per host with
+ * gooroom-notifyd --build-icon-atlas. Every daemon on the host maps the
+ * same file and paints straight from it, so on a terminal server with a
+ * daemon per session all of them share one copy of those icons in the
+ * page cache instead of each decoding its own.
+ *
+ * Layout, native endian: a header, the entry table sorted by name hash,
+ * the names, and the ARGB32 pixels of every entry aligned to 64 bytes. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "gooroom-notify-icon-atlas.h"
+
+#define ATLAS_MAGIC    0x414e4f47  /* "GONA" */
+#define ATLAS_VERSION  1
+#define ATLAS_ALIGN    64
+
+/* the contexts notifications take their icons from */
+static const gchar *atlas_contexts[] = { "Applications", "Status", "Devices", NULL };
+static const gint   atlas_scales[] = { 1, 2 };
+
+typedef struct
+{
+	guint32 magic;
+	guint32 version;
+	guint32 n_entries;
+	guint32 theme_offset;
+	guint32 theme_length;
+	guint8  reserved[44];
+} GooroomNotifyAtlasHeader;
+
+typedef struct
+{
+	guint64 hash;
+	guint32 name_offset;
+	guint32 name_length;
+	gint32  size;
+	gint32  scale;
+	gint32  width;
+	gint32  height;
+	gint32  stride;
+	guint32 reserved;
+	guint64 pixel_offset;
+} GooroomNotifyAtlasEntry;
+
+G_STATIC_ASSERT (sizeof (GooroomNotifyAtlasHeader) == ATLAS_ALIGN);
+G_STATIC_ASSERT (sizeof (GooroomNotifyAtlasEntry) % 8 == 0);
+
+static GMappedFile *atlas = NULL;
+static gchar       *atlas_filename = NULL;
+static const cairo_user_data_key_t mapping_key;
+
+
+/* FNV-1a, it has to give the same result in every process */
+static guint64
+gooroom_notify_icon_atlas_hash (const gchar *name)
+{
+	guint64 h = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+
+	for (; *name; name++) {
+		h ^= (guchar)*name;
+		h *= G_GUINT64_CONSTANT (0x100000001b3);
+	}
+
+	return h;
+}
+
+static gint
+gooroom_notify_icon_atlas_compare_entries (gconstpointer a,
+                                           gconstpointer b)
+{
+	const GooroomNotifyAtlasEntry *ea = a;
+	const GooroomNotifyAtlasEntry *eb = b;
+
+	return (ea->hash > eb->hash) - (ea->hash < eb->hash);
+}
+
+static inline gsize
+gooroom_notify_icon_atlas_align (gsize offset)
+{
+	return (offset + ATLAS_ALIGN - 1) & ~(gsize)(ATLAS_ALIGN - 1);
+}
+
+static gchar *
+gooroom_notify_icon_atlas_get_theme_name (void)
+{
+	gchar *theme_name = NULL;
+	GtkSettings *settings = gtk_settings_get_default ();
+
+	if (settings)
+		g_object_get (settings, "gtk-icon-theme-name", &theme_name, NULL);
+
+	return theme_name;
+}
+
+gboolean
+gooroom_notify_icon_atlas_build (const gchar  *filename,
+                                 const gchar  *theme_name,
+                                 GError      **error)
+{
+	GtkIconTheme *theme;
+	GHashTable *names;
+	GArray *entries;
+	GString *pool;
+	GPtrArray *pixels;
+	GooroomNotifyAtlasHeader header;
+	GHashTableIter iter;
+	cairo_surface_t **images;
+	gpointer name;
+	gchar *default_theme = NULL;
+	gchar *contents, *dir;
+	gsize length, offset;
+	gint size, w, h;
+	guint i, j;
+	gboolean ok;
+
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!theme_name)
+		theme_name = default_theme = gooroom_notify_icon_atlas_get_theme_name ();
+	if (!theme_name) {
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No icon theme is set");
+		return FALSE;
+	}
+
+	theme = gtk_icon_theme_new ();
+	gtk_icon_theme_set_custom_theme (theme, theme_name);
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_DND, &w, &h);
+	size = MIN (w, h);
+
+	names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; atlas_contexts[i]; i++) {
+		GList *list, *l;
+
+		list = gtk_icon_theme_list_icons (theme, atlas_contexts[i]);
+		for (l = list; l; l = l->next)
+			g_hash_table_add (names, l->data);
+		g_list_free (list);
+	}
+
+	entries = g_array_new (FALSE, TRUE, sizeof (GooroomNotifyAtlasEntry));
+	pixels = g_ptr_array_new_with_free_func ((GDestroyNotify)cairo_surface_destroy);
+	pool = g_string_new (NULL);
+
+	g_hash_table_iter_init (&iter, names);
+	while (g_hash_table_iter_next (&iter, &name, NULL)) {
+		for (j = 0; j < G_N_ELEMENTS (atlas_scales); j++) {
+			GooroomNotifyAtlasEntry entry = { 0, };
+			cairo_surface_t *icon, *image;
+			cairo_t *cr;
+
+			icon = gtk_icon_theme_load_surface (theme, name, size, atlas_scales[j], NULL,
+			                                    GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+			if (!icon)
+				continue;
+
+			/* flattened into plain ARGB32 of exactly the device size */
+			image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+			                                    size * atlas_scales[j],
+			                                    size * atlas_scales[j]);
+			cairo_surface_set_device_scale (image, atlas_scales[j], atlas_scales[j]);
+			cr = cairo_create (image);
+			cairo_set_source_surface (cr, icon, 0, 0);
+			cairo_paint (cr);
+			cairo_destroy (cr);
+			cairo_surface_destroy (icon);
+			cairo_surface_flush (image);
+
+			entry.hash = gooroom_notify_icon_atlas_hash (name);
+			entry.name_offset = pool->len;
+			entry.name_length = strlen (name);
+			entry.size = size;
+			entry.scale = atlas_scales[j];
+			entry.width = cairo_image_surface_get_width (image);
+			entry.height = cairo_image_surface_get_height (image);
+			entry.stride = cairo_image_surface_get_stride (image);
+			/* the index into pixels until the layout is known */
+			entry.pixel_offset = pixels->len;
+
+			g_string_append_len (pool, name, entry.name_length);
+			g_array_append_val (entries, entry);
+			g_ptr_array_add (pixels, image);
+		}
+	}
+
+	g_array_sort (entries, gooroom_notify_icon_atlas_compare_entries);
+
+	memset (&header, 0, sizeof (header));
+	header.magic = ATLAS_MAGIC;
+	header.version = ATLAS_VERSION;
+	header.n_entries = entries->len;
+
+	offset = sizeof (header) + entries->len * sizeof (GooroomNotifyAtlasEntry);
+	header.theme_offset = offset + pool->len;
+	header.theme_length = strlen (theme_name);
+	g_string_append (pool, theme_name);
+
+	/* names were relative to the end of the entry table, and the pixels
+	 * were only an index into pixels */
+	images = g_new (cairo_surface_t *, entries->len + 1);
+	length = gooroom_notify_icon_atlas_align (offset + pool->len);
+	for (i = 0; i < entries->len; i++) {
+		GooroomNotifyAtlasEntry *entry = &g_array_index (entries, GooroomNotifyAtlasEntry, i);
+
+		images[i] = g_ptr_array_index (pixels, entry->pixel_offset);
+		entry->name_offset += offset;
+		entry->pixel_offset = length;
+		length = gooroom_notify_icon_atlas_align (length + (gsize)entry->stride * entry->height);
+	}
+
+	contents = g_malloc0 (length);
+	memcpy (contents, &header, sizeof (header));
+	memcpy (contents + sizeof (header), entries->data, entries->len * sizeof (GooroomNotifyAtlasEntry));
+	memcpy (contents + offset, pool->str, pool->len);
+
+	for (i = 0; i < entries->len; i++) {
+		GooroomNotifyAtlasEntry *entry = &g_array_index (entries, GooroomNotifyAtlasEntry, i);
+
+		memcpy (contents + entry->pixel_offset,
+		        cairo_image_surface_get_data (images[i]),
+		        (gsize)entry->stride * entry->height);
+	}
+	g_free (images);
+
+	dir = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dir, 0755);
+	g_free (dir);
+
+	ok = g_file_set_contents (filename, contents, length, error);
+
+	g_free (contents);
+	g_string_free (pool, TRUE);
+	g_ptr_array_unref (pixels);
+	g_array_unref (entries);
+	g_hash_table_unref (names);
+	g_object_unref (theme);
+	g_free (default_theme);
+
+	return ok;
+}
+
+static void
+gooroom_notify_icon_atlas_close (void)
+{
+	g_clear_pointer (&atlas, g_mapped_file_unref);
+}
+
+/* checks every offset once, lookups then trust the file */
+static gboolean
+gooroom_notify_icon_atlas_validate (GMappedFile *mapped,
+                                    const gchar *theme_name)
+{
+	const gchar *contents = g_mapped_file_get_contents (mapped);
+	gsize length = g_mapped_file_get_length (mapped);
+	const GooroomNotifyAtlasHeader *header = (const GooroomNotifyAtlasHeader *)contents;
+	const GooroomNotifyAtlasEntry *entries;
+	gsize table_end;
+	guint i;
+
+	if (length < sizeof (*header) ||
+	    header->magic != ATLAS_MAGIC || header->version != ATLAS_VERSION)
+		return FALSE;
+
+	table_end = sizeof (*header) + (gsize)header->n_entries * sizeof (GooroomNotifyAtlasEntry);
+	if (header->n_entries > length / sizeof (GooroomNotifyAtlasEntry) || table_end > length)
+		return FALSE;
+
+	if ((gsize)header->theme_offset + header->theme_length > length ||
+	    !theme_name || strlen (theme_name) != header->theme_length ||
+	    memcmp (contents + header->theme_offset, theme_name, header->theme_length) != 0)
+		return FALSE;
+
+	entries = (const GooroomNotifyAtlasEntry *)(contents + sizeof (*header));
+	for (i = 0; i < header->n_entries; i++) {
+		const GooroomNotifyAtlasEntry *entry = &entries[i];
+
+		if ((gsize)entry->name_offset + entry->name_length > length ||
+		    entry->width <= 0 || entry->height <= 0 ||
+		    entry->stride != cairo_format_stride_for_width (CAIRO_FORMAT_ARGB32, entry->width) ||
+		    entry->pixel_offset % ATLAS_ALIGN != 0 ||
+		    entry->pixel_offset > length ||
+		    (gsize)entry->stride * entry->height > length - entry->pixel_offset)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void
+gooroom_notify_icon_atlas_theme_changed (GtkIconTheme *theme,
+                                         gpointer      user_data)
+{
+	/* the theme may have been switched to one the atlas is not for */
+	gooroom_notify_icon_atlas_close ();
+	gooroom_notify_icon_atlas_open (atlas_filename);
+}
+
+void
+gooroom_notify_icon_atlas_open (const gchar *filename)
+{
+	gchar *theme_name;
+	GMappedFile *mapped;
+
+	g_return_if_fail (filename != NULL);
+
+	if (!atlas_filename) {
+		atlas_filename = g_strdup (filename);
+		g_signal_connect (gtk_icon_theme_get_default (), "changed",
+		                  G_CALLBACK (gooroom_notify_icon_atlas_theme_changed), NULL);
+	}
+
+	gooroom_notify_icon_atlas_close ();
+
+	/* read-only and never written to, so the pages stay shared with every
+	 * other process mapping the file */
+	mapped = g_mapped_file_new (filename, FALSE, NULL);
+	if (!mapped)
+		return;
+
+	theme_name = gooroom_notify_icon_atlas_get_theme_name ();
+
+	if (gooroom_notify_icon_atlas_validate (mapped, theme_name))
+		atlas = mapped;
+	else
+		g_mapped_file_unref (mapped);
+
+	g_free (theme_name);
+}
+
+cairo_surface_t *
+gooroom_notify_icon_atlas_lookup (const gchar *icon_name,
+                                  gint         size,
+                                  gint         scale)
+{
+	const gchar *contents;
+	const GooroomNotifyAtlasHeader *header;
+	const GooroomNotifyAtlasEntry *entries;
+	cairo_surface_t *surface;
+	guint64 hash;
+	gsize name_length;
+	guint lo, hi, i;
+
+	g_return_val_if_fail (icon_name != NULL, NULL);
+
+	if (!atlas)
+		return NULL;
+
+	contents = g_mapped_file_get_contents (atlas);
+	header = (const GooroomNotifyAtlasHeader *)contents;
+	entries = (const GooroomNotifyAtlasEntry *)(contents + sizeof (*header));
+
+	hash = gooroom_notify_icon_atlas_hash (icon_name);
+	name_length = strlen (icon_name);
+
+	/* first entry with the hash */
+	lo = 0;
+	hi = header->n_entries;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (entries[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo; i < header->n_entries && entries[i].hash == hash; i++) {
+		const GooroomNotifyAtlasEntry *entry = &entries[i];
+
+		if (entry->size != size || entry->scale != scale ||
+		    entry->name_length != name_length ||
+		    memcmp (contents + entry->name_offset, icon_name, name_length) != 0)
+			continue;
+
+		/* source only, drawing into it would fault on the read-only pages */
+		surface = cairo_image_surface_create_for_data ((guchar *)contents + entry->pixel_offset,
+		                                               CAIRO_FORMAT_ARGB32,
+		                                               entry->width, entry->height,
+		                                               entry->stride);
+		cairo_surface_set_device_scale (surface, scale, scale);
+		cairo_surface_set_user_data (surface, &mapping_key, g_mapped_file_ref (atlas),
+		                             (cairo_destroy_func_t)g_mapped_file_unref);
+
+		return surface;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,42 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_ICON_ATLAS_H__
+#define __GOOROOM_NOTIFY_ICON_ATLAS_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+gboolean         gooroom_notify_icon_atlas_build  (const gchar  *filename,
+                                                   const gchar  *theme_name,
+                                                   GError      **error);
+
+/* does nothing if there is no atlas, or it was built for another theme */
+void             gooroom_notify_icon_atlas_open   (const gchar  *filename);
+
+/* returns a new reference to a surface on the shared pages, or NULL; the
+ * pages are read-only, use it as a source only and copy it to draw into it */
+cairo_surface_t *gooroom_notify_icon_atlas_lookup (const gchar  *icon_name,
+                                                   gint          size,
+                                                   gint          scale);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_ICON_ATLAS_H__ */
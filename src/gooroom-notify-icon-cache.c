@@ -0,0 +1,795 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Daemon wide LRU of the icons notifications are shown with. Icons loaded
+ * from files are kept decoded at the size they are displayed, and checked
+ * against the file's modification time on every hit. Themed icons are kept
+ * as GIcons. The whole cache is dropped when the icon theme changes.
+ *
+ * Files are only touched on a small pool of worker threads, so a huge image
+ * or a slow network home never blocks the main loop. A load that takes too
+ * long is failed from the main loop. If its worker had started, the thread
+ * counts as stuck until it comes back, since a hung mount can block it in a
+ * single read. The pool grows by the stuck threads, up to a limit; past it
+ * file icons fail straight away. The cache itself is only used from the
+ * main thread. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gooroom-notify-icon-cache.h"
+#include "gooroom-notify-disk-cache.h"
+#include "gooroom-notify-icon-scale.h"
+#include "common.h"
+
+#define ICON_LOAD_THREADS    2
+#define ICON_LOAD_MAX_STUCK  4
+#define ICON_LOAD_TIMEOUT    (5 * 1000)
+#define ICON_LOAD_CHUNK_SIZE (64 * 1024)
+
+typedef struct
+{
+	gchar   *location;   /* an absolute path or a URI */
+	gchar   *key;
+	gint     size;
+	gint     scale;
+
+	/* of the cached copy, the file is not decoded again if they match */
+	gint64   known_mtime;
+	goffset  known_size;
+
+	/* filled in by the worker, mtime in microseconds */
+	gint64   mtime;
+	goffset  file_size;
+	gint     started;    /* atomic */
+
+	/* main thread only; task is the caller's, NULL once it has returned */
+	GTask        *task;
+	GCancellable *cancellable;
+	GCancellable *caller_cancellable;
+	gulong        cancelled_id;
+	guint         timeout_id;
+	gboolean      stuck;
+} GooroomNotifyIconJob;
+
+typedef struct
+{
+	gchar          *key;
+	gpointer        object;     /* a GObject, or a cairo surface */
+	GDestroyNotify  free_func;
+	gsize           bytes;
+	gint64          mtime;
+	goffset         size;
+	/* the image-data it was rendered from, hits are checked against it */
+	GVariant       *data;
+} GooroomNotifyIconEntry;
+
+static GHashTable *entries = NULL;    /* key -> link in lru */
+static GQueue      lru = G_QUEUE_INIT; /* most recently used first */
+static gsize       budget = GOOROOM_NOTIFY_ICON_CACHE_DEFAULT_BUDGET;
+static gsize       total_bytes = 0;
+static guint64     hits = 0;
+static guint64     misses = 0;
+static guint64     dedup_bytes = 0;
+static guint64     hash_seed = 0;
+
+static GThreadPool *load_pool = NULL;
+static guint        stuck_threads = 0;
+
+
+static void
+gooroom_notify_icon_entry_free (GooroomNotifyIconEntry *entry)
+{
+	entry->free_func (entry->object);
+	if (entry->data)
+		g_variant_unref (entry->data);
+	g_free (entry->key);
+	g_free (entry);
+}
+
+static void
+gooroom_notify_icon_cache_remove_link (GList *link)
+{
+	GooroomNotifyIconEntry *entry = link->data;
+
+	g_queue_delete_link (&lru, link);
+	g_hash_table_remove (entries, entry->key);
+	total_bytes -= entry->bytes;
+	gooroom_notify_icon_entry_free (entry);
+}
+
+static void
+gooroom_notify_icon_cache_trim (void)
+{
+	/* the most recent entry stays even if it is over budget on its own */
+	while (total_bytes > budget && lru.length > 1)
+		gooroom_notify_icon_cache_remove_link (lru.tail);
+}
+
+static void
+gooroom_notify_icon_cache_clear (void)
+{
+	while (lru.tail)
+		gooroom_notify_icon_cache_remove_link (lru.tail);
+}
+
+static void
+gooroom_notify_icon_cache_theme_changed (GtkIconTheme *theme,
+                                         gpointer      user_data)
+{
+	gooroom_notify_icon_cache_clear ();
+}
+
+static void
+gooroom_notify_icon_cache_ensure (void)
+{
+	if (entries)
+		return;
+
+	entries = g_hash_table_new (g_str_hash, g_str_equal);
+
+	g_signal_connect (gtk_icon_theme_get_default (), "changed",
+	                  G_CALLBACK (gooroom_notify_icon_cache_theme_changed), NULL);
+}
+
+static GooroomNotifyIconEntry *
+gooroom_notify_icon_cache_lookup (const gchar *key)
+{
+	GList *link;
+
+	gooroom_notify_icon_cache_ensure ();
+
+	link = g_hash_table_lookup (entries, key);
+	if (!link)
+		return NULL;
+
+	g_queue_unlink (&lru, link);
+	g_queue_push_head_link (&lru, link);
+
+	return link->data;
+}
+
+/* takes over key and the reference to object */
+static GooroomNotifyIconEntry *
+gooroom_notify_icon_cache_insert (gchar          *key,
+                                  gpointer        object,
+                                  GDestroyNotify  free_func,
+                                  gsize           bytes,
+                                  gint64          mtime,
+                                  goffset         size)
+{
+	GooroomNotifyIconEntry *entry;
+
+	entry = g_new0 (GooroomNotifyIconEntry, 1);
+	entry->key = key;
+	entry->object = object;
+	entry->free_func = free_func;
+	entry->bytes = bytes;
+	entry->mtime = mtime;
+	entry->size = size;
+
+	g_queue_push_head (&lru, entry);
+	g_hash_table_insert (entries, entry->key, lru.head);
+	total_bytes += bytes;
+
+	/* never evicts the new entry */
+	gooroom_notify_icon_cache_trim ();
+
+	return entry;
+}
+
+void
+gooroom_notify_icon_cache_set_budget (gsize bytes)
+{
+	budget = bytes;
+
+	if (entries)
+		gooroom_notify_icon_cache_trim ();
+}
+
+static inline gsize
+gooroom_notify_icon_cache_surface_bytes (cairo_surface_t *surface)
+{
+	return (gsize)cairo_image_surface_get_stride (surface)
+	       * cairo_image_surface_get_height (surface);
+}
+
+static inline gchar *
+gooroom_notify_icon_cache_file_key (const gchar *location,
+                                    gint         size,
+                                    gint         scale)
+{
+	return g_strdup_printf ("file\n%d\n%d\n%s", size, scale, location);
+}
+
+static void
+gooroom_notify_icon_job_free (GooroomNotifyIconJob *job)
+{
+	g_clear_object (&job->cancellable);
+	g_free (job->location);
+	g_free (job->key);
+	g_free (job);
+}
+
+/* scales into the device pixels of size x size keeping the aspect ratio,
+ * like gdk_pixbuf_new_from_file_at_size () */
+static void
+gooroom_notify_icon_cache_size_prepared (GdkPixbufLoader *loader,
+                                         gint             width,
+                                         gint             height,
+                                         gpointer         user_data)
+{
+	GooroomNotifyIconJob *job = user_data;
+	gint pixels = job->size * job->scale;
+	gdouble scale;
+
+	if (width <= 0 || height <= 0 || (width <= pixels && height <= pixels))
+		return;
+
+	scale = MIN ((gdouble)pixels / width, (gdouble)pixels / height);
+
+	gdk_pixbuf_loader_set_size (loader,
+	                            MAX ((gint)(width * scale), 1),
+	                            MAX ((gint)(height * scale), 1));
+}
+
+static inline GFile *
+gooroom_notify_icon_cache_get_file (const gchar *location)
+{
+	return g_path_is_absolute (location) ? g_file_new_for_path (location)
+	                                     : g_file_new_for_uri (location);
+}
+
+/* Images are always decoded through a loader, so the size-prepared handler
+ * can ask for the icon size before any pixel is decoded. Loaders that can
+ * decode at a reduced size, like JPEG's DCT scaling, then never hold the
+ * full resolution image. */
+static GdkPixbuf *
+gooroom_notify_icon_cache_decode (GooroomNotifyIconJob  *job,
+                                  GFile                 *file,
+                                  GCancellable          *cancellable,
+                                  GError               **error)
+{
+	guchar *buffer;
+	GInputStream *stream;
+	GdkPixbuf *pixbuf = NULL;
+	GdkPixbufLoader *loader;
+	gboolean ok = TRUE;
+
+	stream = G_INPUT_STREAM (g_file_read (file, cancellable, error));
+	if (!stream)
+		return NULL;
+
+	loader = gdk_pixbuf_loader_new ();
+
+	g_signal_connect (loader, "size-prepared",
+	                  G_CALLBACK (gooroom_notify_icon_cache_size_prepared), job);
+
+	buffer = g_malloc (ICON_LOAD_CHUNK_SIZE);
+
+	while (ok) {
+		gssize n;
+
+		n = g_input_stream_read (stream, buffer, ICON_LOAD_CHUNK_SIZE, cancellable, error);
+		if (n == 0)
+			break;
+
+		ok = (n > 0) && gdk_pixbuf_loader_write (loader, buffer, n, error);
+	}
+
+	g_free (buffer);
+	g_object_unref (stream);
+
+	/* the loader has to be closed either way */
+	if (ok) {
+		ok = gdk_pixbuf_loader_close (loader, error);
+	} else {
+		gdk_pixbuf_loader_close (loader, NULL);
+	}
+
+	if (ok) {
+		pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+		if (pixbuf)
+			g_object_ref (pixbuf);
+		else
+			g_set_error (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_FAILED,
+			             "Failed to load image %s", job->location);
+	}
+
+	g_object_unref (loader);
+
+	return pixbuf;
+}
+
+static void
+gooroom_notify_icon_cache_load_thread (gpointer data,
+                                       gpointer user_data)
+{
+	GFile *file;
+	GFileInfo *info;
+	GdkPixbuf *pixbuf;
+	cairo_surface_t *surface;
+	GError *error = NULL;
+	GTask *task = data;
+	GooroomNotifyIconJob *job = g_task_get_task_data (task);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+
+	/* cancelled as well once it timed out */
+	if (g_cancellable_set_error_if_cancelled (cancellable, &error)) {
+		g_task_return_error (task, error);
+		goto out;
+	}
+
+	g_atomic_int_set (&job->started, TRUE);
+
+	file = gooroom_notify_icon_cache_get_file (job->location);
+
+	/* a notification must not make the daemon go out to the network */
+	if (!g_file_is_native (file)) {
+		g_object_unref (file);
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+		                         "%s is not a local file", job->location);
+		goto out;
+	}
+
+	info = g_file_query_info (file,
+	                          G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+	                          G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+	                          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+	                          G_FILE_QUERY_INFO_NONE, cancellable, &error);
+	if (!info) {
+		g_object_unref (file);
+		g_task_return_error (task, error);
+		goto out;
+	}
+
+	/* a file rewritten within the same second still counts as changed */
+	job->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+	             g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	job->file_size = g_file_info_get_size (info);
+
+	if (job->mtime == job->known_mtime && job->file_size == job->known_size) {
+		/* the cached copy is still good */
+		g_object_unref (info);
+		g_object_unref (file);
+		g_task_return_pointer (task, NULL, NULL);
+		goto out;
+	}
+
+	g_object_unref (info);
+
+	/* rendered by an earlier run of the daemon */
+	surface = gooroom_notify_disk_cache_lookup (job->key, job->mtime, job->file_size);
+	if (surface) {
+		g_object_unref (file);
+		g_task_return_pointer (task, surface, (GDestroyNotify)cairo_surface_destroy);
+		goto out;
+	}
+
+	pixbuf = gooroom_notify_icon_cache_decode (job, file, cancellable, &error);
+	g_object_unref (file);
+
+	if (!pixbuf) {
+		g_task_return_error (task, error);
+		goto out;
+	}
+
+	/* converted for cairo here as well, the main thread only paints it */
+	surface = gooroom_notify_icon_scale_render (pixbuf, job->size, job->scale);
+	g_object_unref (pixbuf);
+
+	gooroom_notify_disk_cache_store (job->key, job->mtime, job->file_size, surface);
+
+	g_task_return_pointer (task, surface, (GDestroyNotify)cairo_surface_destroy);
+
+out:
+	g_object_unref (task);
+}
+
+static void
+gooroom_notify_icon_cache_set_stuck (GooroomNotifyIconJob *job,
+                                     gboolean              stuck)
+{
+	if (job->stuck == stuck)
+		return;
+
+	job->stuck = stuck;
+	stuck_threads += stuck ? 1 : -1;
+
+	/* the other jobs must not wait behind a thread that may never return */
+	g_thread_pool_set_max_threads (load_pool,
+	                               ICON_LOAD_THREADS + MIN (stuck_threads, ICON_LOAD_MAX_STUCK),
+	                               NULL);
+}
+
+static gboolean
+gooroom_notify_icon_cache_load_timed_out (gpointer user_data)
+{
+	GooroomNotifyIconJob *job = user_data;
+
+	job->timeout_id = 0;
+
+	/* a job still waiting for a thread gives up as soon as it gets one */
+	g_cancellable_cancel (job->cancellable);
+	if (g_atomic_int_get (&job->started))
+		gooroom_notify_icon_cache_set_stuck (job, TRUE);
+
+	g_task_return_new_error (job->task, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+	                         "Timed out loading %s", job->location);
+	g_clear_object (&job->task);
+
+	return FALSE;
+}
+
+static void
+gooroom_notify_icon_cache_cancel_job (GCancellable *caller_cancellable,
+                                      gpointer      user_data)
+{
+	g_cancellable_cancel (G_CANCELLABLE (user_data));
+}
+
+static void
+gooroom_notify_icon_cache_load_done (GObject      *source_object,
+                                     GAsyncResult *result,
+                                     gpointer      user_data)
+{
+	GTask *task;
+	GError *error = NULL;
+	cairo_surface_t *surface;
+	GooroomNotifyIconEntry *entry;
+	GooroomNotifyIconJob *job = g_task_get_task_data (G_TASK (result));
+
+	if (job->timeout_id) {
+		g_source_remove (job->timeout_id);
+		job->timeout_id = 0;
+	}
+	if (job->caller_cancellable) {
+		g_cancellable_disconnect (job->caller_cancellable, job->cancelled_id);
+		g_clear_object (&job->caller_cancellable);
+	}
+	gooroom_notify_icon_cache_set_stuck (job, FALSE);
+
+	surface = g_task_propagate_pointer (G_TASK (result), &error);
+
+	/* too late, the caller was told it timed out */
+	if (!job->task) {
+		if (surface)
+			cairo_surface_destroy (surface);
+		g_clear_error (&error);
+		return;
+	}
+
+	task = job->task;
+	job->task = NULL;
+
+	if (error) {
+		g_task_return_error (task, error);
+	} else if (!surface) {
+		entry = gooroom_notify_icon_cache_lookup (job->key);
+		if (entry) {
+			hits++;
+			g_task_return_pointer (task, cairo_surface_reference (entry->object),
+			                       (GDestroyNotify)cairo_surface_destroy);
+		} else {
+			/* evicted while the file was checked */
+			g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+			                         "%s is no longer cached", job->location);
+		}
+	} else {
+		misses++;
+
+		/* drop the stale copy, if any */
+		entry = gooroom_notify_icon_cache_lookup (job->key);
+		if (entry)
+			gooroom_notify_icon_cache_remove_link (lru.head);
+
+		gooroom_notify_icon_cache_insert (g_strdup (job->key), cairo_surface_reference (surface),
+		                                  (GDestroyNotify)cairo_surface_destroy,
+		                                  gooroom_notify_icon_cache_surface_bytes (surface),
+		                                  job->mtime, job->file_size);
+
+		g_task_return_pointer (task, surface, (GDestroyNotify)cairo_surface_destroy);
+	}
+
+	g_object_unref (task);
+}
+
+/* Returns the cached copy without checking whether the file changed, so it
+ * can be shown while gooroom_notify_icon_cache_load_file_async () checks. */
+cairo_surface_t *
+gooroom_notify_icon_cache_peek_file (const gchar *location,
+                                     gint         size,
+                                     gint         scale)
+{
+	gchar *key;
+	GooroomNotifyIconEntry *entry;
+
+	g_return_val_if_fail (location != NULL, NULL);
+
+	key = gooroom_notify_icon_cache_file_key (location, size, scale);
+	entry = gooroom_notify_icon_cache_lookup (key);
+	g_free (key);
+
+	return entry ? cairo_surface_reference (entry->object) : NULL;
+}
+
+/* Decodes the file at the given size on a worker thread, unless the cached
+ * copy is still up to date. Fails with G_IO_ERROR_TIMED_OUT if that takes
+ * longer than ICON_LOAD_TIMEOUT, time spent waiting for a thread included,
+ * even when the worker is blocked on the file system, and with
+ * G_IO_ERROR_BUSY while too many workers are. */
+void
+gooroom_notify_icon_cache_load_file_async (const gchar         *location,
+                                           gint                 size,
+                                           gint                 scale,
+                                           GCancellable        *cancellable,
+                                           GAsyncReadyCallback  callback,
+                                           gpointer             user_data)
+{
+	GTask *task, *load_task;
+	GooroomNotifyIconJob *job;
+	GooroomNotifyIconEntry *entry;
+
+	g_return_if_fail (location != NULL);
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gooroom_notify_icon_cache_load_file_async);
+
+	/* the file system hangs, more threads would only get stuck as well */
+	if (stuck_threads >= ICON_LOAD_MAX_STUCK) {
+		g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_BUSY,
+		                         "Too many icon loads are stuck, not loading %s", location);
+		g_object_unref (task);
+		return;
+	}
+
+	job = g_new0 (GooroomNotifyIconJob, 1);
+	job->location = g_strdup (location);
+	job->key = gooroom_notify_icon_cache_file_key (location, size, scale);
+	job->size = size;
+	job->scale = MAX (scale, 1);
+	job->known_mtime = -1;
+	job->known_size = -1;
+
+	entry = gooroom_notify_icon_cache_lookup (job->key);
+	if (entry) {
+		job->known_mtime = entry->mtime;
+		job->known_size = entry->size;
+	}
+
+	if (!load_pool)
+		load_pool = g_thread_pool_new (gooroom_notify_icon_cache_load_thread, NULL,
+		                               ICON_LOAD_THREADS, FALSE, NULL);
+
+	/* the worker gets a cancellable of its own, which the timeout cancels */
+	job->task = task;
+	job->cancellable = g_cancellable_new ();
+	if (cancellable) {
+		job->caller_cancellable = g_object_ref (cancellable);
+		job->cancelled_id = g_cancellable_connect (cancellable,
+		                                           G_CALLBACK (gooroom_notify_icon_cache_cancel_job),
+		                                           job->cancellable, NULL);
+	}
+	job->timeout_id = g_timeout_add (ICON_LOAD_TIMEOUT, gooroom_notify_icon_cache_load_timed_out, job);
+
+	load_task = g_task_new (NULL, job->cancellable, gooroom_notify_icon_cache_load_done, NULL);
+	g_task_set_task_data (load_task, job, (GDestroyNotify)gooroom_notify_icon_job_free);
+
+	g_thread_pool_push (load_pool, load_task, NULL);
+}
+
+cairo_surface_t *
+gooroom_notify_icon_cache_load_file_finish (GAsyncResult  *result,
+                                            GError       **error)
+{
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+GIcon *
+gooroom_notify_icon_cache_load_themed (const gchar *icon_name)
+{
+	gchar *key;
+	GIcon *icon;
+	GooroomNotifyIconEntry *entry;
+
+	g_return_val_if_fail (icon_name != NULL, NULL);
+
+	key = g_strconcat ("themed\n", icon_name, NULL);
+
+	entry = gooroom_notify_icon_cache_lookup (key);
+	if (entry) {
+		hits++;
+		g_free (key);
+		return G_ICON (g_object_ref (entry->object));
+	}
+
+	misses++;
+
+	icon = g_themed_icon_new_with_default_fallbacks (icon_name);
+
+	/* a themed icon is only a list of names */
+	gooroom_notify_icon_cache_insert (key, g_object_ref (icon), g_object_unref,
+	                                  2 * strlen (key) + 64, 0, 0);
+
+	return icon;
+}
+
+/* 64 bit multiply-xorshift hash, eight bytes at a time */
+static guint64
+gooroom_notify_icon_cache_hash (const guchar *data,
+                                gsize         len,
+                                guint64       seed)
+{
+	const guint64 m = G_GUINT64_CONSTANT (0x9e3779b97f4a7c15);
+	guint64 h = seed ^ (len * m);
+	guint64 w;
+
+	for (; len >= 8; data += 8, len -= 8) {
+		memcpy (&w, data, 8);
+		w *= m;
+		w ^= w >> 32;
+		h = (h ^ w) * m;
+	}
+
+	if (len > 0) {
+		w = 0;
+		memcpy (&w, data, len);
+		w *= m;
+		w ^= w >> 32;
+		h = (h ^ w) * m;
+	}
+
+	h ^= h >> 29;
+	h *= m;
+	h ^= h >> 32;
+
+	return h;
+}
+
+static gboolean
+gooroom_notify_icon_cache_data_equal (GVariant *a,
+                                      GVariant *b)
+{
+	gsize len;
+
+	if (a == b)
+		return TRUE;
+
+	if (!a || !b)
+		return FALSE;
+
+	/* both are (iiibiiay), so equal values serialize the same */
+	len = g_variant_get_size (a);
+
+	return len == g_variant_get_size (b) &&
+	       memcmp (g_variant_get_data (a), g_variant_get_data (b), len) == 0;
+}
+
+/* Clients tend to send the same avatar or album art with every message, so
+ * image-data is looked up by a hash of its header and pixels before it is
+ * copied or scaled. All notifications showing it share one surface. */
+cairo_surface_t *
+gooroom_notify_icon_cache_load_image_data (GVariant *image_data,
+                                           gint      size,
+                                           gint      scale)
+{
+	gchar *key;
+	gint32 width, height, rowstride, bits_per_sample, channels;
+	gboolean has_alpha;
+	GVariant *pixel_data;
+	GdkPixbuf *pixbuf;
+	cairo_surface_t *surface;
+	GooroomNotifyIconEntry *entry;
+	gint32 header[6];
+	guint64 hash;
+	gsize len;
+
+	g_return_val_if_fail (image_data != NULL, NULL);
+
+	if (!g_variant_is_of_type (image_data, G_VARIANT_TYPE ("(iiibiiay)"))) {
+		g_warning ("Image data is not the correct type");
+		return NULL;
+	}
+
+	g_variant_get (image_data, "(iiibii@ay)",
+	               &width, &height, &rowstride, &has_alpha,
+	               &bits_per_sample, &channels, &pixel_data);
+
+	header[0] = width;
+	header[1] = height;
+	header[2] = rowstride;
+	header[3] = !!has_alpha;
+	header[4] = bits_per_sample;
+	header[5] = channels;
+
+	/* so that nobody can prepare a collision ahead of time */
+	if (G_UNLIKELY (!hash_seed))
+		hash_seed = ((guint64)g_random_int () << 32) | g_random_int () | 1;
+
+	len = g_variant_get_size (pixel_data);
+	hash = gooroom_notify_icon_cache_hash ((const guchar *)header, sizeof (header), hash_seed);
+	hash = gooroom_notify_icon_cache_hash (g_variant_get_data (pixel_data), len, hash);
+	g_variant_unref (pixel_data);
+
+	key = g_strdup_printf ("data\n%d\n%d\n%016" G_GINT64_MODIFIER "x\n%" G_GSIZE_FORMAT,
+	                       size, scale, hash, len);
+
+	/* the hash only finds the candidate, the bytes decide */
+	entry = gooroom_notify_icon_cache_lookup (key);
+	if (entry && gooroom_notify_icon_cache_data_equal (entry->data, image_data)) {
+		hits++;
+		dedup_bytes += len;
+		g_free (key);
+		return cairo_surface_reference (entry->object);
+	}
+
+	/* a collision, it is rendered again in its place */
+	if (entry)
+		gooroom_notify_icon_cache_remove_link (lru.head);
+
+	misses++;
+
+	/* validates the data */
+	pixbuf = notify_pixbuf_from_image_data (image_data);
+	if (!pixbuf) {
+		g_free (key);
+		return NULL;
+	}
+
+	surface = gooroom_notify_icon_scale_render (pixbuf, size, scale);
+	g_object_unref (pixbuf);
+
+	if (!surface) {
+		g_free (key);
+		return NULL;
+	}
+
+	entry = gooroom_notify_icon_cache_insert (key, cairo_surface_reference (surface),
+	                                          (GDestroyNotify)cairo_surface_destroy,
+	                                          gooroom_notify_icon_cache_surface_bytes (surface) +
+	                                          g_variant_get_size (image_data),
+	                                          0, 0);
+	entry->data = g_variant_ref (image_data);
+
+	return surface;
+}
+
+void
+gooroom_notify_icon_cache_get_stats (guint64 *hits_out,
+                                     guint64 *misses_out,
+                                     guint64 *dedup_bytes_out,
+                                     gsize   *bytes_out,
+                                     guint   *entries_out)
+{
+	if (hits_out)
+		*hits_out = hits;
+	if (misses_out)
+		*misses_out = misses;
+	if (dedup_bytes_out)
+		*dedup_bytes_out = dedup_bytes;
+	if (bytes_out)
+		*bytes_out = total_bytes;
+	if (entries_out)
+		*entries_out = lru.length;
+}
@@ -0,0 +1,60 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_ICON_CACHE_H__
+#define __GOOROOM_NOTIFY_ICON_CACHE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define GOOROOM_NOTIFY_ICON_CACHE_DEFAULT_BUDGET (4 * 1024 * 1024)
+
+void       gooroom_notify_icon_cache_set_budget  (gsize        bytes);
+
+/* All of them return a new reference. Images are rendered to fit into
+ * size x size logical pixels at the given scale factor, and the surfaces
+ * are shared by everyone asking for the same image at the same scale.
+ * A file location is an absolute path or the URI of a local file. */
+cairo_surface_t *gooroom_notify_icon_cache_peek_file        (const gchar         *location,
+                                                             gint                 size,
+                                                             gint                 scale);
+void             gooroom_notify_icon_cache_load_file_async  (const gchar         *location,
+                                                             gint                 size,
+                                                             gint                 scale,
+                                                             GCancellable        *cancellable,
+                                                             GAsyncReadyCallback  callback,
+                                                             gpointer             user_data);
+cairo_surface_t *gooroom_notify_icon_cache_load_file_finish (GAsyncResult        *result,
+                                                             GError             **error);
+cairo_surface_t *gooroom_notify_icon_cache_load_image_data  (GVariant            *image_data,
+                                                             gint                 size,
+                                                             gint                 scale);
+
+GIcon     *gooroom_notify_icon_cache_load_themed (const gchar *icon_name);
+
+void       gooroom_notify_icon_cache_get_stats   (guint64     *hits,
+                                                  guint64     *misses,
+                                                  guint64     *dedup_bytes,
+                                                  gsize       *bytes,
+                                                  guint       *entries);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_ICON_CACHE_H__ */
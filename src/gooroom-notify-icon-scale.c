@@ -0,0 +1,250 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Scales icons down with a box filter and writes them out premultiplied in
+ * cairo's native ARGB32 layout in the same pass, so they can be painted
+ * without another conversion. Every source pixel is premultiplied with the
+ * exact rounding of x * a / 255 before it is summed, which lets the SSE2
+ * path produce the same bits as the plain C one. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+/* the tests build a second copy without SSE2 to compare against */
+#if defined (__SSE2__) && !defined (GOOROOM_NOTIFY_ICON_SCALE_SCALAR)
+#define GOOROOM_NOTIFY_ICON_SCALE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "gooroom-notify-icon-scale.h"
+
+static inline guint32
+gooroom_notify_icon_scale_premultiply (guint32 c,
+                                       guint32 a)
+{
+	guint32 t = c * a + 128;
+
+	return (t + (t >> 8)) >> 8;
+}
+
+/* sums the premultiplied R, G, B and the A of n pixels */
+static inline void
+gooroom_notify_icon_scale_sum_rgba (const guchar *p,
+                                    gint          n,
+                                    guint32      *sums)
+{
+	gint i = 0;
+
+#ifdef GOOROOM_NOTIFY_ICON_SCALE_SSE2
+	if (n >= 4) {
+		const __m128i zero = _mm_setzero_si128 ();
+		const __m128i alpha_mask = _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+		const __m128i alpha_one = _mm_set_epi16 (255, 0, 0, 0, 255, 0, 0, 0);
+		const __m128i round = _mm_set1_epi16 (128);
+		__m128i acc = zero;
+		guint32 out[4];
+
+		for (; i + 4 <= n; i += 4) {
+			__m128i px = _mm_loadu_si128 ((const __m128i *)(p + i * 4));
+			__m128i halves[2];
+			gint h;
+
+			halves[0] = _mm_unpacklo_epi8 (px, zero);
+			halves[1] = _mm_unpackhi_epi8 (px, zero);
+
+			for (h = 0; h < 2; h++) {
+				__m128i v = halves[h];
+				__m128i a, t;
+
+				/* a a a a per pixel, the alpha lane itself is kept
+				 * by multiplying it with 255 */
+				a = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (v, _MM_SHUFFLE (3, 3, 3, 3)),
+				                         _MM_SHUFFLE (3, 3, 3, 3));
+				a = _mm_or_si128 (_mm_andnot_si128 (alpha_mask, a), alpha_one);
+
+				/* fits 16 bits: 255 * 255 + 128 + 254 */
+				t = _mm_add_epi16 (_mm_mullo_epi16 (v, a), round);
+				t = _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+
+				acc = _mm_add_epi32 (acc, _mm_unpacklo_epi16 (t, zero));
+				acc = _mm_add_epi32 (acc, _mm_unpackhi_epi16 (t, zero));
+			}
+		}
+
+		_mm_storeu_si128 ((__m128i *)out, acc);
+		sums[0] += out[0];
+		sums[1] += out[1];
+		sums[2] += out[2];
+		sums[3] += out[3];
+	}
+#endif
+
+	for (; i < n; i++) {
+		const guchar *q = p + i * 4;
+
+		sums[0] += gooroom_notify_icon_scale_premultiply (q[0], q[3]);
+		sums[1] += gooroom_notify_icon_scale_premultiply (q[1], q[3]);
+		sums[2] += gooroom_notify_icon_scale_premultiply (q[2], q[3]);
+		sums[3] += q[3];
+	}
+}
+
+static inline void
+gooroom_notify_icon_scale_sum_rgb (const guchar *p,
+                                   gint          n,
+                                   guint32      *sums)
+{
+	gint i;
+
+	for (i = 0; i < n; i++) {
+		sums[0] += p[i * 3];
+		sums[1] += p[i * 3 + 1];
+		sums[2] += p[i * 3 + 2];
+	}
+	sums[3] += 255 * n;
+}
+
+void
+gooroom_notify_icon_scale_fit (gint  width,
+                               gint  height,
+                               gint  size,
+                               gint *fit_width,
+                               gint *fit_height)
+{
+	*fit_width = width;
+	*fit_height = height;
+
+	if (width > size || height > size) {
+		if (width > height) {
+			*fit_width = size;
+			*fit_height = size * ((gdouble)height / width);
+		} else {
+			*fit_width = size * ((gdouble)width / height);
+			*fit_height = size;
+		}
+	}
+}
+
+cairo_surface_t *
+gooroom_notify_icon_scale_pixbuf (GdkPixbuf *pixbuf,
+                                  gint       width,
+                                  gint       height)
+{
+	gint x, y, sw, sh, src_stride, dest_stride, n_channels;
+	gint *x_bounds;
+	const guchar *src;
+	guchar *dest;
+	gboolean has_alpha;
+	cairo_surface_t *surface;
+
+	g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
+	g_return_val_if_fail (gdk_pixbuf_get_colorspace (pixbuf) == GDK_COLORSPACE_RGB &&
+	                      gdk_pixbuf_get_bits_per_sample (pixbuf) == 8, NULL);
+
+	sw = gdk_pixbuf_get_width (pixbuf);
+	sh = gdk_pixbuf_get_height (pixbuf);
+	src = gdk_pixbuf_read_pixels (pixbuf);
+	src_stride = gdk_pixbuf_get_rowstride (pixbuf);
+	has_alpha = gdk_pixbuf_get_has_alpha (pixbuf);
+	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+	width = CLAMP (width, 1, sw);
+	height = CLAMP (height, 1, sh);
+
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+	if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+		return surface;
+
+	cairo_surface_flush (surface);
+	dest = cairo_image_surface_get_data (surface);
+	dest_stride = cairo_image_surface_get_stride (surface);
+
+	/* every destination pixel covers at least one source pixel, as the
+	 * image is only ever made smaller */
+	x_bounds = g_new (gint, width + 1);
+	for (x = 0; x <= width; x++)
+		x_bounds[x] = (gint64)x * sw / width;
+
+	for (y = 0; y < height; y++) {
+		gint sy0 = (gint64)y * sh / height;
+		gint sy1 = (gint64)(y + 1) * sh / height;
+		guint32 *out = (guint32 *)(dest + y * dest_stride);
+
+		for (x = 0; x < width; x++) {
+			gint sx0 = x_bounds[x];
+			gint n = x_bounds[x + 1] - sx0;
+			guint32 count = n * (sy1 - sy0);
+			guint32 sums[4] = { 0, 0, 0, 0 };
+			guint32 r, g, b, a;
+			gint sy;
+
+			for (sy = sy0; sy < sy1; sy++) {
+				const guchar *row = src + (gsize)sy * src_stride + sx0 * n_channels;
+
+				if (has_alpha && n_channels == 4)
+					gooroom_notify_icon_scale_sum_rgba (row, n, sums);
+				else
+					gooroom_notify_icon_scale_sum_rgb (row, n, sums);
+			}
+
+			r = (sums[0] + count / 2) / count;
+			g = (sums[1] + count / 2) / count;
+			b = (sums[2] + count / 2) / count;
+			a = (sums[3] + count / 2) / count;
+
+			out[x] = (a << 24) | (r << 16) | (g << 8) | b;
+		}
+	}
+
+	g_free (x_bounds);
+
+	cairo_surface_mark_dirty (surface);
+
+	return surface;
+}
+
+cairo_surface_t *
+gooroom_notify_icon_scale_render (GdkPixbuf *pixbuf,
+                                  gint       size,
+                                  gint       scale)
+{
+	gint w, h, pw, ph;
+	cairo_surface_t *surface;
+
+	g_return_val_if_fail (GDK_IS_PIXBUF (pixbuf), NULL);
+
+	pw = gdk_pixbuf_get_width (pixbuf);
+	ph = gdk_pixbuf_get_height (pixbuf);
+
+	/* logical size first, a small image is not blown up for HiDPI */
+	gooroom_notify_icon_scale_fit (pw, ph, size, &w, &h);
+	w = MAX (w, 1);
+	h = MAX (h, 1);
+
+	surface = gooroom_notify_icon_scale_pixbuf (pixbuf,
+	                                            MIN (w * MAX (scale, 1), pw),
+	                                            MIN (h * MAX (scale, 1), ph));
+
+	cairo_surface_set_device_scale (surface,
+	                                (gdouble)cairo_image_surface_get_width (surface) / w,
+	                                (gdouble)cairo_image_surface_get_height (surface) / h);
+
+	return surface;
+}
@@ -0,0 +1,48 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_ICON_SCALE_H__
+#define __GOOROOM_NOTIFY_ICON_SCALE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* the size width x height is shown at inside a size x size box */
+void gooroom_notify_icon_scale_fit (gint  width,
+                                    gint  height,
+                                    gint  size,
+                                    gint *fit_width,
+                                    gint *fit_height);
+
+/* Returns a new CAIRO_FORMAT_ARGB32 surface holding the pixbuf scaled down
+ * to width x height. Images are never scaled up. */
+cairo_surface_t *gooroom_notify_icon_scale_pixbuf (GdkPixbuf *pixbuf,
+                                                   gint       width,
+                                                   gint       height);
+
+/* Returns a surface that paints at most size x size logical pixels large,
+ * with as many device pixels as the pixbuf has for a scale factor of scale */
+cairo_surface_t *gooroom_notify_icon_scale_render (GdkPixbuf *pixbuf,
+                                                   gint       size,
+                                                   gint       scale);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_ICON_SCALE_H__ */
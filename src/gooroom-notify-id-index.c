@@ -0,0 +1,234 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* The active notifications by id: an open addressing table with linear
+ * probing over the ids themselves. Removal shifts the following entries of
+ * the probe run back instead of leaving tombstones, so lookups never get
+ * slower as notifications come and go. Ordered traversal, needed only to
+ * lay all notifications out again, goes through a separate insertion-ordered
+ * queue. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gooroom-notify-id-index.h"
+
+#define ID_INDEX_MIN_SIZE 16
+
+typedef struct
+{
+	guint32   id;       /* 0 marks a free slot */
+	gpointer  value;
+	GList    *order;    /* its link in the insertion order */
+} GooroomNotifyIdSlot;
+
+struct _GooroomNotifyIdIndex
+{
+	GooroomNotifyIdSlot *slots;
+	guint                mask;
+	guint                n_entries;
+	GQueue               order;
+	GDestroyNotify       value_destroy;
+};
+
+
+static inline guint
+gooroom_notify_id_index_hash (GooroomNotifyIdIndex *index,
+                              guint32               id)
+{
+	/* ids are sequential, the multiplication spreads them over the table */
+	return (id * 0x9E3779B1u) & index->mask;
+}
+
+static GooroomNotifyIdSlot *
+gooroom_notify_id_index_find (GooroomNotifyIdIndex *index,
+                              guint32               id)
+{
+	guint i = gooroom_notify_id_index_hash (index, id);
+
+	while (index->slots[i].id != 0) {
+		if (index->slots[i].id == id)
+			return &index->slots[i];
+		i = (i + 1) & index->mask;
+	}
+
+	return NULL;
+}
+
+static void
+gooroom_notify_id_index_place (GooroomNotifyIdIndex      *index,
+                               const GooroomNotifyIdSlot *slot)
+{
+	guint i = gooroom_notify_id_index_hash (index, slot->id);
+
+	while (index->slots[i].id != 0)
+		i = (i + 1) & index->mask;
+
+	index->slots[i] = *slot;
+}
+
+static void
+gooroom_notify_id_index_resize (GooroomNotifyIdIndex *index,
+                                guint                 size)
+{
+	GooroomNotifyIdSlot *old_slots = index->slots;
+	guint i, old_size = index->mask + 1;
+
+	index->slots = g_new0 (GooroomNotifyIdSlot, size);
+	index->mask = size - 1;
+
+	for (i = 0; i < old_size; i++) {
+		if (old_slots[i].id != 0)
+			gooroom_notify_id_index_place (index, &old_slots[i]);
+	}
+
+	g_free (old_slots);
+}
+
+GooroomNotifyIdIndex *
+gooroom_notify_id_index_new (GDestroyNotify value_destroy)
+{
+	GooroomNotifyIdIndex *index = g_new0 (GooroomNotifyIdIndex, 1);
+
+	index->slots = g_new0 (GooroomNotifyIdSlot, ID_INDEX_MIN_SIZE);
+	index->mask = ID_INDEX_MIN_SIZE - 1;
+	g_queue_init (&index->order);
+	index->value_destroy = value_destroy;
+
+	return index;
+}
+
+void
+gooroom_notify_id_index_free (GooroomNotifyIdIndex *index)
+{
+	if (!index)
+		return;
+
+	while (index->order.head)
+		gooroom_notify_id_index_remove (index, GPOINTER_TO_UINT (index->order.head->data));
+
+	g_free (index->slots);
+	g_free (index);
+}
+
+void
+gooroom_notify_id_index_insert (GooroomNotifyIdIndex *index,
+                                guint32               id,
+                                gpointer              value)
+{
+	GooroomNotifyIdSlot slot;
+
+	g_return_if_fail (index != NULL && id != 0);
+	g_return_if_fail (gooroom_notify_id_index_find (index, id) == NULL);
+
+	/* keep the load under 3/4, probe runs stay short */
+	if ((index->n_entries + 1) * 4 > (index->mask + 1) * 3)
+		gooroom_notify_id_index_resize (index, (index->mask + 1) * 2);
+
+	g_queue_push_tail (&index->order, GUINT_TO_POINTER (id));
+
+	slot.id = id;
+	slot.value = value;
+	slot.order = index->order.tail;
+	gooroom_notify_id_index_place (index, &slot);
+
+	index->n_entries++;
+}
+
+gpointer
+gooroom_notify_id_index_lookup (GooroomNotifyIdIndex *index,
+                                guint32               id)
+{
+	GooroomNotifyIdSlot *slot;
+
+	if (id == 0)
+		return NULL;
+
+	slot = gooroom_notify_id_index_find (index, id);
+
+	return slot ? slot->value : NULL;
+}
+
+gboolean
+gooroom_notify_id_index_remove (GooroomNotifyIdIndex *index,
+                                guint32               id)
+{
+	GooroomNotifyIdSlot *slot;
+	gpointer value;
+	guint i, j;
+
+	if (id == 0 || !(slot = gooroom_notify_id_index_find (index, id)))
+		return FALSE;
+
+	value = slot->value;
+	g_queue_delete_link (&index->order, slot->order);
+
+	/* pull back every entry of the run that may no longer be reachable
+	 * from its home slot across the hole */
+	i = slot - index->slots;
+	j = i;
+	for (;;) {
+		guint home;
+
+		j = (j + 1) & index->mask;
+		if (index->slots[j].id == 0)
+			break;
+
+		home = gooroom_notify_id_index_hash (index, index->slots[j].id);
+		if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+			continue;
+
+		index->slots[i] = index->slots[j];
+		i = j;
+	}
+	index->slots[i].id = 0;
+	index->slots[i].value = NULL;
+	index->slots[i].order = NULL;
+
+	index->n_entries--;
+
+	/* the value goes last, destroying it may reenter the index */
+	if (index->value_destroy)
+		index->value_destroy (value);
+
+	return TRUE;
+}
+
+guint
+gooroom_notify_id_index_size (GooroomNotifyIdIndex *index)
+{
+	return index->n_entries;
+}
+
+void
+gooroom_notify_id_index_foreach (GooroomNotifyIdIndex     *index,
+                                 GooroomNotifyIdIndexFunc  func,
+                                 gpointer                  user_data)
+{
+	GList *l = index->order.head;
+
+	while (l) {
+		GList *next = l->next;
+		guint32 id = GPOINTER_TO_UINT (l->data);
+
+		func (id, gooroom_notify_id_index_lookup (index, id), user_data);
+		l = next;
+	}
+}
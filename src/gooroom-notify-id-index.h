@@ -0,0 +1,53 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_ID_INDEX_H__
+#define __GOOROOM_NOTIFY_ID_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GooroomNotifyIdIndex GooroomNotifyIdIndex;
+
+typedef void (*GooroomNotifyIdIndexFunc) (guint32  id,
+                                          gpointer value,
+                                          gpointer user_data);
+
+GooroomNotifyIdIndex *gooroom_notify_id_index_new     (GDestroyNotify value_destroy);
+void                  gooroom_notify_id_index_free    (GooroomNotifyIdIndex *index);
+
+/* id is never 0 and not in the index yet */
+void                  gooroom_notify_id_index_insert  (GooroomNotifyIdIndex *index,
+                                                       guint32               id,
+                                                       gpointer              value);
+gpointer              gooroom_notify_id_index_lookup  (GooroomNotifyIdIndex *index,
+                                                       guint32               id);
+gboolean              gooroom_notify_id_index_remove  (GooroomNotifyIdIndex *index,
+                                                       guint32               id);
+guint                 gooroom_notify_id_index_size    (GooroomNotifyIdIndex *index);
+
+/* oldest entry first; func may remove the entry it is given */
+void                  gooroom_notify_id_index_foreach (GooroomNotifyIdIndex     *index,
+                                                       GooroomNotifyIdIndexFunc  func,
+                                                       gpointer                  user_data);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_ID_INDEX_H__ */
@@ -0,0 +1,99 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* App names, icon names, bus names and action ids come from a handful of
+ * clients and repeat in every notification they send. The table maps each
+ * string to its single copy, which carries its own reference count. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gooroom-notify-intern.h"
+
+typedef struct
+{
+	guint ref_count;
+	gchar str[1];
+} GooroomNotifyInternEntry;
+
+/* the key is the str member of its entry */
+static GHashTable *table = NULL;
+
+
+static inline GooroomNotifyInternEntry *
+gooroom_notify_intern_entry (const gchar *str)
+{
+	return (GooroomNotifyInternEntry *)(str - G_STRUCT_OFFSET (GooroomNotifyInternEntry, str));
+}
+
+const gchar *
+gooroom_notify_intern_ref (const gchar *str)
+{
+	GooroomNotifyInternEntry *entry;
+	const gchar *interned;
+	gsize len;
+
+	if (!str)
+		return NULL;
+
+	if (!table)
+		table = g_hash_table_new (g_str_hash, g_str_equal);
+
+	interned = g_hash_table_lookup (table, str);
+	if (interned) {
+		gooroom_notify_intern_entry (interned)->ref_count++;
+		return interned;
+	}
+
+	len = strlen (str);
+	entry = g_malloc (G_STRUCT_OFFSET (GooroomNotifyInternEntry, str) + len + 1);
+	entry->ref_count = 1;
+	memcpy (entry->str, str, len + 1);
+
+	g_hash_table_add (table, entry->str);
+
+	return entry->str;
+}
+
+void
+gooroom_notify_intern_unref (const gchar *str)
+{
+	GooroomNotifyInternEntry *entry;
+
+	if (!str)
+		return;
+
+	entry = gooroom_notify_intern_entry (str);
+
+	g_return_if_fail (entry->ref_count > 0);
+
+	if (--entry->ref_count == 0) {
+		g_hash_table_remove (table, entry->str);
+		g_free (entry);
+	}
+}
+
+guint
+gooroom_notify_intern_get_size (void)
+{
+	return table ? g_hash_table_size (table) : 0;
+}
@@ -0,0 +1,36 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_INTERN_H__
+#define __GOOROOM_NOTIFY_INTERN_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Equal strings share one copy, so interned strings compare by pointer.
+ * Every ref is paired with an unref; the copy goes with the last one. */
+const gchar *gooroom_notify_intern_ref   (const gchar *str);
+void         gooroom_notify_intern_unref (const gchar *str);
+
+guint        gooroom_notify_intern_get_size (void);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_INTERN_H__ */
@@ -0,0 +1,143 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A small LRU of shaped layouts. Layouts are keyed by font, resolution,
+ * font options, language, wrap width, line count and text, so a
+ * notification that is replaced with the same text, or the same text shown
+ * again, is not shaped a second time. A layout whose own context changed
+ * since it was shaped is shaped again. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gooroom-notify-layout-cache.h"
+
+#define LAYOUT_CACHE_SIZE 32
+
+typedef struct
+{
+	gchar       *key;
+	PangoLayout *layout;
+	/* of the layout's context when it was shaped */
+	guint        serial;
+} GooroomNotifyLayoutEntry;
+
+static GHashTable *entries = NULL;    /* key -> link in lru */
+static GQueue      lru = G_QUEUE_INIT; /* most recently used first */
+
+
+static void
+gooroom_notify_layout_entry_free (GooroomNotifyLayoutEntry *entry)
+{
+	g_object_unref (entry->layout);
+	g_free (entry->key);
+	g_free (entry);
+}
+
+static PangoLayout *
+gooroom_notify_layout_cache_shape (PangoContext *context,
+                                   const gchar  *text,
+                                   gboolean      use_markup,
+                                   gint          width,
+                                   gint          lines)
+{
+	PangoLayout *layout;
+
+	layout = pango_layout_new (context);
+
+	if (use_markup)
+		pango_layout_set_markup (layout, text, -1);
+	else
+		pango_layout_set_text (layout, text, -1);
+
+	pango_layout_set_width (layout, width * PANGO_SCALE);
+	pango_layout_set_height (layout, -MAX (lines, 1));
+	pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
+	pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+
+	return layout;
+}
+
+PangoLayout *
+gooroom_notify_layout_cache_lookup (PangoContext *context,
+                                    const gchar  *text,
+                                    gboolean      use_markup,
+                                    gint          width,
+                                    gint          lines)
+{
+	GList *link;
+	gchar *font, *key;
+	const cairo_font_options_t *options;
+	GooroomNotifyLayoutEntry *entry;
+
+	g_return_val_if_fail (PANGO_IS_CONTEXT (context), NULL);
+
+	if (!text)
+		text = "";
+
+	if (!entries)
+		entries = g_hash_table_new (g_str_hash, g_str_equal);
+
+	font = pango_font_description_to_string (pango_context_get_font_description (context));
+	options = pango_cairo_context_get_font_options (context);
+	key = g_strdup_printf ("%s\n%g\n%lx\n%s\n%d\n%d\n%d\n%s",
+	                       font,
+	                       pango_cairo_context_get_resolution (context),
+	                       options ? cairo_font_options_hash (options) : 0UL,
+	                       pango_language_to_string (pango_context_get_language (context)),
+	                       use_markup, width, lines, text);
+	g_free (font);
+
+	link = g_hash_table_lookup (entries, key);
+	if (link) {
+		entry = link->data;
+
+		if (pango_context_get_serial (pango_layout_get_context (entry->layout)) == entry->serial) {
+			g_free (key);
+
+			g_queue_unlink (&lru, link);
+			g_queue_push_head_link (&lru, link);
+
+			return g_object_ref (entry->layout);
+		}
+
+		/* its context was changed under it, by a DPI or font change */
+		g_queue_delete_link (&lru, link);
+		g_hash_table_remove (entries, entry->key);
+		gooroom_notify_layout_entry_free (entry);
+	}
+
+	entry = g_new0 (GooroomNotifyLayoutEntry, 1);
+	entry->key = key;
+	entry->layout = gooroom_notify_layout_cache_shape (context, text, use_markup, width, lines);
+	entry->serial = pango_context_get_serial (context);
+
+	g_queue_push_head (&lru, entry);
+	g_hash_table_insert (entries, entry->key, lru.head);
+
+	while (lru.length > LAYOUT_CACHE_SIZE) {
+		GooroomNotifyLayoutEntry *old = g_queue_pop_tail (&lru);
+
+		g_hash_table_remove (entries, old->key);
+		gooroom_notify_layout_entry_free (old);
+	}
+
+	return g_object_ref (entry->layout);
+}
@@ -0,0 +1,36 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_LAYOUT_CACHE_H__
+#define __GOOROOM_NOTIFY_LAYOUT_CACHE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* returns a new reference to a shared layout, which must not be modified */
+PangoLayout *gooroom_notify_layout_cache_lookup (PangoContext *context,
+                                                 const gchar  *text,
+                                                 gboolean      use_markup,
+                                                 gint          width,
+                                                 gint          lines);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_LAYOUT_CACHE_H__ */
@@ -0,0 +1,747 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* An overlay is a single popup window covering a monitor. It draws every
+ * notification placed on that monitor itself, so only one X window and one
+ * compositor surface exist no matter how many notifications are shown.
+ * The GooroomNotifyWindow objects are kept as the model; they are never
+ * mapped, and pointer events on the overlay are routed back to them. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gooroom-notify-overlay.h"
+
+/* same as the daemon's, the label is capped to it */
+#define BODY_LINES 2
+
+typedef struct
+{
+	GdkRectangle  rect;       /* relative to the notification */
+	GtkWidget    *button;     /* the action's button in the notification window */
+	PangoLayout  *layout;
+	gint          text_x, text_y;
+	const gchar  *action_id;  /* owned by the notification window */
+} GooroomNotifyOverlayAction;
+
+typedef struct
+{
+	GooroomNotifyWindow *window;
+	GdkRectangle         rect;       /* in overlay coordinates */
+	gint                 width;
+	gint                 height;
+
+	cairo_surface_t     *icon;
+	GdkRectangle         icon_rect;
+	PangoLayout         *summary;
+	gint                 summary_x, summary_y;
+	PangoLayout         *body;
+	gint                 body_x, body_y;
+	gint                 gauge_value;
+	GdkRectangle         gauge_rect;
+	GArray              *actions;
+} GooroomNotifyOverlayItem;
+
+struct _GooroomNotifyOverlay
+{
+	GtkWindow parent;
+
+	GdkRectangle area;
+	GList *items;
+
+	GooroomNotifyOverlayItem *hovered;
+	GooroomNotifyOverlayItem *pressed;
+};
+
+typedef struct
+{
+	GtkWindowClass parent_class;
+} GooroomNotifyOverlayClass;
+
+
+G_DEFINE_TYPE (GooroomNotifyOverlay, gooroom_notify_overlay, GTK_TYPE_WINDOW)
+
+
+static void
+gooroom_notify_overlay_item_clear (GooroomNotifyOverlayItem *item)
+{
+	guint i;
+
+	g_clear_pointer (&item->icon, cairo_surface_destroy);
+	g_clear_object (&item->summary);
+	g_clear_object (&item->body);
+
+	if (item->actions) {
+		for (i = 0; i < item->actions->len; i++)
+			g_object_unref (g_array_index (item->actions, GooroomNotifyOverlayAction, i).layout);
+		g_array_free (item->actions, TRUE);
+		item->actions = NULL;
+	}
+}
+
+static void
+gooroom_notify_overlay_item_free (GooroomNotifyOverlayItem *item)
+{
+	gooroom_notify_overlay_item_clear (item);
+	g_free (item);
+}
+
+/* border and padding of a widget in its current state */
+static void
+gooroom_notify_overlay_get_insets (GtkWidget *widget,
+                                   GtkBorder *insets)
+{
+	GtkStyleContext *context = gtk_widget_get_style_context (widget);
+	GtkStateFlags state = gtk_style_context_get_state (context);
+	GtkBorder border, padding;
+
+	gtk_style_context_get_border (context, state, &border);
+	gtk_style_context_get_padding (context, state, &padding);
+
+	insets->left = border.left + padding.left;
+	insets->right = border.right + padding.right;
+	insets->top = border.top + padding.top;
+	insets->bottom = border.bottom + padding.bottom;
+}
+
+/* Mirrors the box layout of gooroom-notify-window.ui: an icon and the
+ * summary on the first row, the body below and the action buttons at the
+ * bottom. A gauge replaces everything but the icon. Sizes and spacings are
+ * taken from the notification's own widgets, so the theme applies. */
+static void
+gooroom_notify_overlay_item_layout (GooroomNotifyOverlayItem *item,
+                                    gint                      scale)
+{
+	GooroomNotifyWindow *window = item->window;
+	GtkWidget *box, *gauge, *button_box;
+	GtkBorder insets;
+	GList *children, *l;
+	PangoRectangle ext;
+	gint icon_w, icon_h, content_w, width, border_width, row_spacing;
+	gint x, y, top, text_x, row_h, i;
+
+	gooroom_notify_overlay_item_clear (item);
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_DND, &icon_w, &icon_h);
+
+	box = gooroom_notify_window_get_part (window, GOOROOM_NOTIFY_WINDOW_PART_BOX);
+	gooroom_notify_overlay_get_insets (box, &insets);
+	row_spacing = gtk_box_get_spacing (GTK_BOX (box));
+
+	border_width = gtk_container_get_border_width (GTK_CONTAINER (window));
+	gtk_window_get_default_size (GTK_WINDOW (window), &width, NULL);
+
+	content_w = width - 2 * border_width - insets.left - insets.right;
+	x = border_width + insets.left;
+	y = top = border_width + insets.top;
+
+	item->icon = gooroom_notify_window_create_icon_surface (window, icon_w, scale);
+	item->gauge_value = gooroom_notify_window_get_gauge_value (window);
+
+	if (item->icon && gooroom_notify_window_get_icon_only (window)) {
+		item->icon_rect.x = x + (content_w - icon_w) / 2;
+		item->icon_rect.y = y;
+		item->icon_rect.width = icon_w;
+		item->icon_rect.height = icon_h;
+		y += icon_h;
+		goto out;
+	}
+
+	row_h = 0;
+	text_x = x;
+
+	if (item->icon) {
+		GtkWidget *header = gooroom_notify_window_get_part (window, GOOROOM_NOTIFY_WINDOW_PART_HEADER);
+
+		item->icon_rect.x = x;
+		item->icon_rect.y = y;
+		item->icon_rect.width = icon_w;
+		item->icon_rect.height = icon_h;
+		row_h = icon_h;
+		text_x = x + icon_w + gtk_box_get_spacing (GTK_BOX (header));
+	}
+
+	gauge = gooroom_notify_window_get_part (window, GOOROOM_NOTIFY_WINDOW_PART_GAUGE);
+	if (item->gauge_value >= 0 && gauge) {
+		gint gauge_h;
+
+		gtk_widget_get_preferred_height (gauge, &gauge_h, NULL);
+
+		if (row_h)
+			y += row_h + row_spacing;
+		item->gauge_rect.x = x;
+		item->gauge_rect.y = y;
+		item->gauge_rect.width = content_w;
+		item->gauge_rect.height = gauge_h;
+		y += gauge_h;
+		goto out;
+	}
+
+	item->summary = gooroom_notify_window_ref_summary_layout (window, content_w - (text_x - x), 1);
+	if (item->summary) {
+		pango_layout_get_pixel_extents (item->summary, NULL, &ext);
+
+		item->summary_x = text_x;
+		item->summary_y = y + MAX (0, (row_h - ext.height) / 2);
+		row_h = MAX (row_h, ext.height);
+	}
+	y += row_h;
+
+	item->body = gooroom_notify_window_ref_body_layout (window, content_w, BODY_LINES);
+	if (item->body) {
+		if (row_h)
+			y += row_spacing;
+		pango_layout_get_pixel_extents (item->body, NULL, &ext);
+
+		item->body_x = x;
+		item->body_y = y;
+		y += ext.height;
+	}
+
+	/* the window has a button for every action it shows */
+	button_box = gooroom_notify_window_get_part (window, GOOROOM_NOTIFY_WINDOW_PART_BUTTON_BOX);
+	children = gtk_container_get_children (GTK_CONTAINER (button_box));
+	for (l = children; l; l = l->next) {
+		GooroomNotifyOverlayAction action;
+		GtkWidget *label = gtk_bin_get_child (GTK_BIN (l->data));
+		GtkBorder button_insets;
+
+		if (!GTK_IS_LABEL (label))
+			continue;
+
+		action.button = l->data;
+		action.layout = gtk_widget_create_pango_layout (label, NULL);
+		pango_layout_set_markup (action.layout, gtk_label_get_label (GTK_LABEL (label)), -1);
+
+		gooroom_notify_overlay_get_insets (action.button, &button_insets);
+		pango_layout_get_pixel_extents (action.layout, NULL, &ext);
+		action.rect.width = ext.width + button_insets.left + button_insets.right;
+		action.rect.height = ext.height + button_insets.top + button_insets.bottom;
+		action.text_x = button_insets.left;
+		action.text_y = button_insets.top;
+		action.action_id = g_object_get_data (G_OBJECT (action.button), "--action-id");
+
+		if (!item->actions)
+			item->actions = g_array_new (FALSE, TRUE, sizeof (GooroomNotifyOverlayAction));
+		g_array_append_val (item->actions, action);
+	}
+	g_list_free (children);
+
+	if (item->actions) {
+		gint ax = x + content_w, max_h = 0;
+		gint spacing = gtk_box_get_spacing (GTK_BOX (button_box));
+
+		if (y > top)
+			y += row_spacing;
+
+		/* the button box is packed at the end */
+		for (i = item->actions->len - 1; i >= 0; i--) {
+			GooroomNotifyOverlayAction *action;
+
+			action = &g_array_index (item->actions, GooroomNotifyOverlayAction, i);
+			ax -= action->rect.width;
+			action->rect.x = ax;
+			action->rect.y = y;
+			ax -= spacing;
+			max_h = MAX (max_h, action->rect.height);
+		}
+		y += max_h;
+	}
+
+out:
+	item->width = width;
+	item->height = y + insets.bottom + border_width;
+}
+
+static GooroomNotifyOverlayItem *
+gooroom_notify_overlay_find_item (GooroomNotifyOverlay *overlay,
+                                  GooroomNotifyWindow  *window)
+{
+	GList *l;
+
+	for (l = overlay->items; l; l = l->next) {
+		GooroomNotifyOverlayItem *item = l->data;
+		if (item->window == window)
+			return item;
+	}
+
+	return NULL;
+}
+
+static GooroomNotifyOverlayItem *
+gooroom_notify_overlay_item_at (GooroomNotifyOverlay *overlay,
+                                gdouble               x,
+                                gdouble               y)
+{
+	GList *l;
+
+	for (l = overlay->items; l; l = l->next) {
+		GooroomNotifyOverlayItem *item = l->data;
+
+		if (x >= item->rect.x && x < item->rect.x + item->rect.width &&
+		    y >= item->rect.y && y < item->rect.y + item->rect.height)
+			return item;
+	}
+
+	return NULL;
+}
+
+static inline void
+gooroom_notify_overlay_damage_item (GooroomNotifyOverlay     *overlay,
+                                    GooroomNotifyOverlayItem *item)
+{
+	gtk_widget_queue_draw_area (GTK_WIDGET (overlay),
+	                            item->rect.x, item->rect.y,
+	                            item->rect.width, item->rect.height);
+}
+
+static void
+gooroom_notify_overlay_update_shape (GooroomNotifyOverlay *overlay)
+{
+	GList *l;
+	cairo_region_t *region;
+
+	region = cairo_region_create ();
+	for (l = overlay->items; l; l = l->next) {
+		GooroomNotifyOverlayItem *item = l->data;
+		cairo_region_union_rectangle (region, &item->rect);
+	}
+
+	/* outside the notifications the overlay neither shows up nor takes
+	 * any input */
+	gtk_widget_shape_combine_region (GTK_WIDGET (overlay), region);
+	gtk_widget_input_shape_combine_region (GTK_WIDGET (overlay), region);
+	cairo_region_destroy (region);
+
+	if (overlay->items)
+		gtk_widget_show (GTK_WIDGET (overlay));
+	else
+		gtk_widget_hide (GTK_WIDGET (overlay));
+}
+
+static void
+gooroom_notify_overlay_set_hovered (GooroomNotifyOverlay     *overlay,
+                                    GooroomNotifyOverlayItem *item)
+{
+	GooroomNotifyOverlayItem *old = overlay->hovered;
+
+	if (old == item)
+		return;
+
+	overlay->hovered = item;
+
+	if (old) {
+		gooroom_notify_overlay_damage_item (overlay, old);
+		gooroom_notify_window_set_hovered (old->window, FALSE);
+	}
+
+	if (item) {
+		gooroom_notify_overlay_damage_item (overlay, item);
+		gooroom_notify_window_set_hovered (item->window, TRUE);
+	}
+}
+
+/* Takes the notification off this overlay without telling the window,
+ * which may be moving on to another overlay. */
+static void
+gooroom_notify_overlay_detach (GooroomNotifyOverlay *overlay,
+                               GooroomNotifyWindow  *window)
+{
+	GooroomNotifyOverlayItem *item;
+
+	item = gooroom_notify_overlay_find_item (overlay, window);
+	if (!item)
+		return;
+
+	if (overlay->hovered == item)
+		overlay->hovered = NULL;
+	if (overlay->pressed == item)
+		overlay->pressed = NULL;
+
+	gooroom_notify_overlay_damage_item (overlay, item);
+
+	overlay->items = g_list_remove (overlay->items, item);
+	gooroom_notify_overlay_item_free (item);
+
+	gooroom_notify_overlay_update_shape (overlay);
+}
+
+static void
+gooroom_notify_overlay_draw_item (GooroomNotifyOverlay     *overlay,
+                                  GooroomNotifyOverlayItem *item,
+                                  cairo_t                  *cr)
+{
+	guint i;
+	gdouble opacity;
+	gint border_width;
+	GtkStyleContext *context;
+	GtkStateFlags state;
+	GtkWidget *gauge;
+
+	opacity = gooroom_notify_window_get_paint_opacity (item->window);
+	if (opacity <= 0.0)
+		return;
+
+	cairo_save (cr);
+
+	/* a sliding notification is clipped by its own bounds, like the
+	 * window would clip it */
+	cairo_rectangle (cr, item->rect.x, item->rect.y, item->rect.width, item->rect.height);
+	cairo_clip (cr);
+	cairo_translate (cr,
+	                 item->rect.x + gooroom_notify_window_get_slide_offset (item->window),
+	                 item->rect.y);
+
+	cairo_push_group (cr);
+
+	/* the box is drawn as its widget would be, hover and press included */
+	border_width = gtk_container_get_border_width (GTK_CONTAINER (item->window));
+	context = gtk_widget_get_style_context (gooroom_notify_window_get_part (item->window,
+	                                                                        GOOROOM_NOTIFY_WINDOW_PART_BOX));
+	gtk_style_context_save (context);
+	state = gtk_style_context_get_state (context);
+	if (item == overlay->pressed)
+		state |= GTK_STATE_FLAG_ACTIVE;
+	if (item == overlay->hovered)
+		state |= GTK_STATE_FLAG_PRELIGHT;
+	gtk_style_context_set_state (context, state);
+	gtk_render_background (context, cr, border_width, border_width,
+	                       item->width - 2 * border_width, item->height - 2 * border_width);
+	gtk_render_frame (context, cr, border_width, border_width,
+	                  item->width - 2 * border_width, item->height - 2 * border_width);
+	gtk_style_context_restore (context);
+
+	if (item->icon) {
+		cairo_set_source_surface (cr, item->icon, item->icon_rect.x, item->icon_rect.y);
+		cairo_paint (cr);
+	}
+
+	gauge = gooroom_notify_window_get_part (item->window, GOOROOM_NOTIFY_WINDOW_PART_GAUGE);
+	if (item->gauge_value >= 0 && gauge) {
+		GdkRectangle *r = &item->gauge_rect;
+		gdouble filled = r->width * item->gauge_value / 100.0;
+
+		/* the progress bar's own nodes */
+		context = gtk_widget_get_style_context (gauge);
+		gtk_style_context_save_named (context, "trough");
+		gtk_render_background (context, cr, r->x, r->y, r->width, r->height);
+		gtk_render_frame (context, cr, r->x, r->y, r->width, r->height);
+		if (filled > 0) {
+			gtk_style_context_save_named (context, "progress");
+			gtk_render_background (context, cr, r->x, r->y, filled, r->height);
+			gtk_render_frame (context, cr, r->x, r->y, filled, r->height);
+			gtk_style_context_restore (context);
+		}
+		gtk_style_context_restore (context);
+	}
+
+	if (item->summary) {
+		context = gtk_widget_get_style_context (gooroom_notify_window_get_part (item->window,
+		                                                                        GOOROOM_NOTIFY_WINDOW_PART_SUMMARY));
+		gtk_render_layout (context, cr, item->summary_x, item->summary_y, item->summary);
+	}
+
+	if (item->body) {
+		context = gtk_widget_get_style_context (gooroom_notify_window_get_part (item->window,
+		                                                                        GOOROOM_NOTIFY_WINDOW_PART_BODY));
+		gtk_render_layout (context, cr, item->body_x, item->body_y, item->body);
+	}
+
+	for (i = 0; item->actions && i < item->actions->len; i++) {
+		GooroomNotifyOverlayAction *action;
+		GdkRectangle *r;
+
+		action = &g_array_index (item->actions, GooroomNotifyOverlayAction, i);
+		r = &action->rect;
+
+		context = gtk_widget_get_style_context (action->button);
+		gtk_render_background (context, cr, r->x, r->y, r->width, r->height);
+		gtk_render_frame (context, cr, r->x, r->y, r->width, r->height);
+
+		context = gtk_widget_get_style_context (gtk_bin_get_child (GTK_BIN (action->button)));
+		gtk_render_layout (context, cr, r->x + action->text_x, r->y + action->text_y, action->layout);
+	}
+
+	cairo_pop_group_to_source (cr);
+	cairo_paint_with_alpha (cr, opacity);
+
+	cairo_restore (cr);
+}
+
+static gboolean
+gooroom_notify_overlay_draw (GtkWidget *widget,
+                             cairo_t   *cr)
+{
+	GList *l;
+	GdkRectangle clip;
+	GooroomNotifyOverlay *overlay = GOOROOM_NOTIFY_OVERLAY (widget);
+
+	if (!gdk_cairo_get_clip_rectangle (cr, &clip))
+		return TRUE;
+
+	cairo_save (cr);
+	cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_rgba (cr, 0.0, 0.0, 0.0, 0.0);
+	cairo_paint (cr);
+	cairo_restore (cr);
+
+	/* only the notifications inside the damaged area are repainted */
+	for (l = overlay->items; l; l = l->next) {
+		GooroomNotifyOverlayItem *item = l->data;
+
+		if (gdk_rectangle_intersect (&item->rect, &clip, NULL))
+			gooroom_notify_overlay_draw_item (overlay, item, cr);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+gooroom_notify_overlay_motion_notify (GtkWidget      *widget,
+                                      GdkEventMotion *evt)
+{
+	GooroomNotifyOverlay *overlay = GOOROOM_NOTIFY_OVERLAY (widget);
+
+	gooroom_notify_overlay_set_hovered (overlay,
+	                                    gooroom_notify_overlay_item_at (overlay, evt->x, evt->y));
+
+	return FALSE;
+}
+
+static gboolean
+gooroom_notify_overlay_leave_notify (GtkWidget        *widget,
+                                     GdkEventCrossing *evt)
+{
+	gooroom_notify_overlay_set_hovered (GOOROOM_NOTIFY_OVERLAY (widget), NULL);
+
+	return FALSE;
+}
+
+static gboolean
+gooroom_notify_overlay_button_press (GtkWidget      *widget,
+                                     GdkEventButton *evt)
+{
+	GooroomNotifyOverlay *overlay = GOOROOM_NOTIFY_OVERLAY (widget);
+
+	overlay->pressed = gooroom_notify_overlay_item_at (overlay, evt->x, evt->y);
+
+	return FALSE;
+}
+
+static gboolean
+gooroom_notify_overlay_button_release (GtkWidget      *widget,
+                                       GdkEventButton *evt)
+{
+	guint i;
+	gchar *action_id = NULL;
+	GooroomNotifyWindow *window;
+	GooroomNotifyOverlayItem *item;
+	GooroomNotifyOverlay *overlay = GOOROOM_NOTIFY_OVERLAY (widget);
+
+	item = gooroom_notify_overlay_item_at (overlay, evt->x, evt->y);
+	if (!item || item != overlay->pressed) {
+		overlay->pressed = NULL;
+		return FALSE;
+	}
+	overlay->pressed = NULL;
+
+	for (i = 0; item->actions && i < item->actions->len; i++) {
+		GooroomNotifyOverlayAction *action;
+		gdouble x = evt->x - item->rect.x;
+		gdouble y = evt->y - item->rect.y;
+
+		action = &g_array_index (item->actions, GooroomNotifyOverlayAction, i);
+		if (x >= action->rect.x && x < action->rect.x + action->rect.width &&
+		    y >= action->rect.y && y < action->rect.y + action->rect.height) {
+			action_id = g_strdup (action->action_id);
+			break;
+		}
+	}
+
+	/* the daemon takes the item off the overlay and destroys the window
+	 * from the closed handler, so nothing of it may be touched after this */
+	window = g_object_ref (item->window);
+	if (action_id)
+		gooroom_notify_window_invoke_action (window, action_id);
+	else
+		gooroom_notify_window_closed (window, GOOROOM_NOTIFY_CLOSE_REASON_DISMISSED);
+	g_object_unref (window);
+
+	g_free (action_id);
+
+	return FALSE;
+}
+
+static void
+gooroom_notify_overlay_finalize (GObject *object)
+{
+	GooroomNotifyOverlay *overlay = GOOROOM_NOTIFY_OVERLAY (object);
+
+	g_list_free_full (overlay->items, (GDestroyNotify)gooroom_notify_overlay_item_free);
+
+	G_OBJECT_CLASS (gooroom_notify_overlay_parent_class)->finalize (object);
+}
+
+static void
+gooroom_notify_overlay_init (GooroomNotifyOverlay *overlay)
+{
+	GtkWidget *widget = GTK_WIDGET (overlay);
+
+	gtk_window_set_type_hint (GTK_WINDOW (overlay), GDK_WINDOW_TYPE_HINT_NOTIFICATION);
+	gtk_widget_set_app_paintable (widget, TRUE);
+	gtk_widget_add_events (widget,
+	                       GDK_POINTER_MOTION_MASK | GDK_LEAVE_NOTIFY_MASK |
+	                       GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK);
+}
+
+static void
+gooroom_notify_overlay_class_init (GooroomNotifyOverlayClass *klass)
+{
+	GObjectClass *gobject_class = (GObjectClass *)klass;
+	GtkWidgetClass *widget_class = (GtkWidgetClass *)klass;
+
+	gobject_class->finalize = gooroom_notify_overlay_finalize;
+
+	widget_class->draw = gooroom_notify_overlay_draw;
+	widget_class->motion_notify_event = gooroom_notify_overlay_motion_notify;
+	widget_class->leave_notify_event = gooroom_notify_overlay_leave_notify;
+	widget_class->button_press_event = gooroom_notify_overlay_button_press;
+	widget_class->button_release_event = gooroom_notify_overlay_button_release;
+}
+
+/* An overlay is not switched between visuals, the daemon replaces it
+ * when the compositing state changes. */
+GtkWidget *
+gooroom_notify_overlay_new (GdkMonitor *monitor,
+                            gboolean    composited)
+{
+	GdkScreen *screen;
+	GdkVisual *visual = NULL;
+	GooroomNotifyOverlay *overlay;
+
+	g_return_val_if_fail (GDK_IS_MONITOR (monitor), NULL);
+
+	overlay = g_object_new (GOOROOM_TYPE_NOTIFY_OVERLAY,
+	                        "type", GTK_WINDOW_POPUP, NULL);
+
+	screen = gtk_widget_get_screen (GTK_WIDGET (overlay));
+	if (composited)
+		visual = gdk_screen_get_rgba_visual (screen);
+	if (visual == NULL)
+		visual = gdk_screen_get_system_visual (screen);
+
+	gtk_widget_set_visual (GTK_WIDGET (overlay), visual);
+
+	gdk_monitor_get_geometry (monitor, &overlay->area);
+
+	gtk_window_move (GTK_WINDOW (overlay), overlay->area.x, overlay->area.y);
+	gtk_widget_set_size_request (GTK_WIDGET (overlay), overlay->area.width, overlay->area.height);
+
+	return GTK_WIDGET (overlay);
+}
+
+/* Size the notification takes up once drawn by an overlay, used for its
+ * placement before it is added. */
+void
+gooroom_notify_overlay_measure (GooroomNotifyWindow *window,
+                                gint                *width,
+                                gint                *height)
+{
+	GooroomNotifyOverlayItem item = { 0, };
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	item.window = window;
+	gooroom_notify_overlay_item_layout (&item, 1);
+
+	if (width)
+		*width = item.width;
+	if (height)
+		*height = item.height;
+
+	gooroom_notify_overlay_item_clear (&item);
+}
+
+/* Adds the notification at its placed geometry, or updates it if it is
+ * already shown. A notification on another overlay is moved over. */
+void
+gooroom_notify_overlay_add (GooroomNotifyOverlay *overlay,
+                            GooroomNotifyWindow  *window)
+{
+	GtkWidget *old;
+	GdkRectangle *geometry;
+	GooroomNotifyOverlayItem *item;
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_OVERLAY (overlay));
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	old = gooroom_notify_window_get_overlay (window);
+	if (old && old != GTK_WIDGET (overlay))
+		gooroom_notify_overlay_detach (GOOROOM_NOTIFY_OVERLAY (old), window);
+
+	item = gooroom_notify_overlay_find_item (overlay, window);
+	if (item) {
+		gooroom_notify_overlay_damage_item (overlay, item);
+	} else {
+		item = g_new0 (GooroomNotifyOverlayItem, 1);
+		item->window = window;
+		overlay->items = g_list_append (overlay->items, item);
+	}
+
+	gooroom_notify_window_set_icon_scale (window, gtk_widget_get_scale_factor (GTK_WIDGET (overlay)));
+	gooroom_notify_overlay_item_layout (item, gtk_widget_get_scale_factor (GTK_WIDGET (overlay)));
+
+	geometry = gooroom_notify_window_get_geometry (window);
+	item->rect.x = geometry->x - overlay->area.x;
+	item->rect.y = geometry->y - overlay->area.y;
+	item->rect.width = item->width;
+	item->rect.height = item->height;
+
+	gooroom_notify_overlay_update_shape (overlay);
+	gooroom_notify_overlay_damage_item (overlay, item);
+
+	gooroom_notify_window_set_overlay (window, GTK_WIDGET (overlay));
+}
+
+void
+gooroom_notify_overlay_remove (GooroomNotifyOverlay *overlay,
+                               GooroomNotifyWindow  *window)
+{
+	g_return_if_fail (GOOROOM_IS_NOTIFY_OVERLAY (overlay));
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	gooroom_notify_overlay_detach (overlay, window);
+
+	if (gooroom_notify_window_get_overlay (window) == GTK_WIDGET (overlay))
+		gooroom_notify_window_set_overlay (window, NULL);
+}
+
+void
+gooroom_notify_overlay_damage (GooroomNotifyOverlay *overlay,
+                               GooroomNotifyWindow  *window)
+{
+	GooroomNotifyOverlayItem *item;
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_OVERLAY (overlay));
+
+	item = gooroom_notify_overlay_find_item (overlay, window);
+	if (item)
+		gooroom_notify_overlay_damage_item (overlay, item);
+}
@@ -0,0 +1,54 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_OVERLAY_H__
+#define __GOOROOM_NOTIFY_OVERLAY_H__
+
+#include <gtk/gtk.h>
+
+#include "gooroom-notify-window.h"
+
+G_BEGIN_DECLS
+
+#define GOOROOM_TYPE_NOTIFY_OVERLAY     (gooroom_notify_overlay_get_type ())
+#define GOOROOM_NOTIFY_OVERLAY(obj)     (G_TYPE_CHECK_INSTANCE_CAST ((obj), GOOROOM_TYPE_NOTIFY_OVERLAY, GooroomNotifyOverlay))
+#define GOOROOM_IS_NOTIFY_OVERLAY(obj)  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GOOROOM_TYPE_NOTIFY_OVERLAY))
+
+typedef struct _GooroomNotifyOverlay  GooroomNotifyOverlay;
+
+GType gooroom_notify_overlay_get_type (void) G_GNUC_CONST;
+
+GtkWidget *gooroom_notify_overlay_new (GdkMonitor *monitor,
+                                       gboolean composited);
+
+void gooroom_notify_overlay_measure (GooroomNotifyWindow *window,
+                                     gint *width,
+                                     gint *height);
+
+void gooroom_notify_overlay_add (GooroomNotifyOverlay *overlay,
+                                 GooroomNotifyWindow *window);
+void gooroom_notify_overlay_remove (GooroomNotifyOverlay *overlay,
+                                    GooroomNotifyWindow *window);
+
+void gooroom_notify_overlay_damage (GooroomNotifyOverlay *overlay,
+                                    GooroomNotifyWindow *window);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_OVERLAY_H__ */
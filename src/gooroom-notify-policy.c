@@ -0,0 +1,253 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Per application policies, read from a key file with one group per app
+ * name as the application sends it:
+ *
+ *   [Firefox]
+ *   mute=false
+ *   urgency=low
+ *   max-timeout=5
+ *   allowed-hints=urgency;desktop-entry
+ *   strip-images=true
+ *
+ * The group "*" applies to every application without a group of its own.
+ * max-timeout is in seconds like the expire-timeout setting. The file is
+ * compiled into a hash table once per change, so looking an app up is
+ * all a notification pays. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gio/gio.h>
+
+#include "gooroom-notify-policy.h"
+
+#define POLICY_FALLBACK_GROUP "*"
+
+typedef struct
+{
+	GHashTable          *apps;
+	GooroomNotifyPolicy *fallback;
+} GooroomNotifyPolicyTable;
+
+static GooroomNotifyPolicyTable *policies = NULL;
+static GFile *policy_file = NULL;
+static GFileMonitor *policy_monitor = NULL;
+
+
+static void
+gooroom_notify_policy_free (gpointer data)
+{
+	GooroomNotifyPolicy *policy = data;
+
+	if (policy->allowed_hints)
+		g_hash_table_destroy (policy->allowed_hints);
+
+	g_slice_free (GooroomNotifyPolicy, policy);
+}
+
+static void
+gooroom_notify_policy_table_free (GooroomNotifyPolicyTable *table)
+{
+	if (!table)
+		return;
+
+	g_hash_table_destroy (table->apps);
+	g_slice_free (GooroomNotifyPolicyTable, table);
+}
+
+static GooroomNotifyPolicy *
+gooroom_notify_policy_compile (GKeyFile    *keyfile,
+                               const gchar *group)
+{
+	GooroomNotifyPolicy *policy = g_slice_new0 (GooroomNotifyPolicy);
+	gchar *urgency;
+	gchar **hints;
+	gint i;
+
+	if (g_key_file_get_boolean (keyfile, group, "mute", NULL))
+		policy->flags |= GOOROOM_NOTIFY_POLICY_MUTE;
+
+	if (g_key_file_get_boolean (keyfile, group, "strip-images", NULL))
+		policy->flags |= GOOROOM_NOTIFY_POLICY_STRIP_IMAGES;
+
+	urgency = g_key_file_get_string (keyfile, group, "urgency", NULL);
+	if (urgency) {
+		policy->flags |= GOOROOM_NOTIFY_POLICY_URGENCY;
+		if (g_str_equal (urgency, "low")) {
+			policy->urgency = 0;
+		} else if (g_str_equal (urgency, "critical")) {
+			policy->urgency = 2;
+		} else {
+			if (!g_str_equal (urgency, "normal"))
+				g_warning ("Unknown urgency \"%s\" for \"%s\"", urgency, group);
+			policy->urgency = 1;
+		}
+		g_free (urgency);
+	}
+
+	if (g_key_file_has_key (keyfile, group, "max-timeout", NULL)) {
+		gint seconds = g_key_file_get_integer (keyfile, group, "max-timeout", NULL);
+
+		if (seconds > 0) {
+			policy->flags |= GOOROOM_NOTIFY_POLICY_MAX_TIMEOUT;
+			policy->max_timeout = MIN (seconds, G_MAXINT / 1000) * 1000;
+		}
+	}
+
+	hints = g_key_file_get_string_list (keyfile, group, "allowed-hints", NULL, NULL);
+	if (hints) {
+		policy->flags |= GOOROOM_NOTIFY_POLICY_FILTER_HINTS;
+		policy->allowed_hints = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+		/* clients send either spelling of most hints */
+		for (i = 0; hints[i]; i++) {
+			g_hash_table_add (policy->allowed_hints, g_strdup (hints[i]));
+			g_hash_table_add (policy->allowed_hints, g_strdelimit (g_strdup (hints[i]), "-", '_'));
+			g_hash_table_add (policy->allowed_hints, g_strdelimit (g_strdup (hints[i]), "_", '-'));
+		}
+		g_strfreev (hints);
+	}
+
+	return policy;
+}
+
+static void
+gooroom_notify_policy_reload (void)
+{
+	GooroomNotifyPolicyTable *table = NULL;
+	GKeyFile *keyfile;
+	GError *error = NULL;
+	gchar *path, **groups;
+	gint i;
+
+	path = g_file_get_path (policy_file);
+	keyfile = g_key_file_new ();
+
+	if (!g_key_file_load_from_file (keyfile, path, G_KEY_FILE_NONE, &error)) {
+		/* a broken file is likely being edited, keep what we have */
+		if (g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+			gooroom_notify_policy_table_free (policies);
+			policies = NULL;
+		} else {
+			g_warning ("Failed to load %s: %s", path, error->message);
+		}
+		g_error_free (error);
+		g_key_file_free (keyfile);
+		g_free (path);
+		return;
+	}
+
+	groups = g_key_file_get_groups (keyfile, NULL);
+	for (i = 0; groups[i]; i++) {
+		GooroomNotifyPolicy *policy = gooroom_notify_policy_compile (keyfile, groups[i]);
+
+		if (!table) {
+			table = g_slice_new0 (GooroomNotifyPolicyTable);
+			table->apps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+			                                     gooroom_notify_policy_free);
+		}
+
+		g_hash_table_replace (table->apps, g_strdup (groups[i]), policy);
+		if (g_str_equal (groups[i], POLICY_FALLBACK_GROUP))
+			table->fallback = policy;
+	}
+	g_strfreev (groups);
+
+	gooroom_notify_policy_table_free (policies);
+	policies = table;
+
+	g_key_file_free (keyfile);
+	g_free (path);
+}
+
+static void
+gooroom_notify_policy_file_changed (GFileMonitor      *monitor,
+                                    GFile             *file,
+                                    GFile             *other_file,
+                                    GFileMonitorEvent  event_type,
+                                    gpointer           user_data)
+{
+	/* a new file is read once it is written, CREATED comes before that;
+	 * editors that save by renaming show up as moves */
+	switch (event_type) {
+		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		case G_FILE_MONITOR_EVENT_DELETED:
+		case G_FILE_MONITOR_EVENT_RENAMED:
+		case G_FILE_MONITOR_EVENT_MOVED_IN:
+		case G_FILE_MONITOR_EVENT_MOVED_OUT:
+			gooroom_notify_policy_reload ();
+			break;
+		default:
+			break;
+	}
+}
+
+void
+gooroom_notify_policy_set_file (const gchar *path)
+{
+	gchar *default_path = NULL;
+
+	if (!path || !*path) {
+		default_path = g_build_filename (g_get_user_config_dir (), "gooroom-notifyd", "policy", NULL);
+		path = default_path;
+	}
+
+	if (policy_monitor) {
+		g_file_monitor_cancel (policy_monitor);
+		g_clear_object (&policy_monitor);
+	}
+	g_clear_object (&policy_file);
+
+	policy_file = g_file_new_for_path (path);
+	policy_monitor = g_file_monitor_file (policy_file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+	if (policy_monitor)
+		g_signal_connect (policy_monitor, "changed",
+		                  G_CALLBACK (gooroom_notify_policy_file_changed), NULL);
+
+	gooroom_notify_policy_reload ();
+
+	g_free (default_path);
+}
+
+const GooroomNotifyPolicy *
+gooroom_notify_policy_lookup (const gchar *app_name)
+{
+	GooroomNotifyPolicy *policy = NULL;
+
+	if (!policies)
+		return NULL;
+
+	if (app_name)
+		policy = g_hash_table_lookup (policies->apps, app_name);
+
+	return policy ? policy : policies->fallback;
+}
+
+gboolean
+gooroom_notify_policy_allows_hint (const GooroomNotifyPolicy *policy,
+                                   const gchar               *hint)
+{
+	if (!policy || !(policy->flags & GOOROOM_NOTIFY_POLICY_FILTER_HINTS))
+		return TRUE;
+
+	return g_hash_table_contains (policy->allowed_hints, hint);
+}
@@ -0,0 +1,57 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_POLICY_H__
+#define __GOOROOM_NOTIFY_POLICY_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+	GOOROOM_NOTIFY_POLICY_MUTE         = 1 << 0,
+	GOOROOM_NOTIFY_POLICY_URGENCY      = 1 << 1,
+	GOOROOM_NOTIFY_POLICY_MAX_TIMEOUT  = 1 << 2,
+	GOOROOM_NOTIFY_POLICY_FILTER_HINTS = 1 << 3,
+	GOOROOM_NOTIFY_POLICY_STRIP_IMAGES = 1 << 4,
+} GooroomNotifyPolicyFlags;
+
+typedef struct
+{
+	guint       flags;
+	guint8      urgency;
+	/* in milliseconds */
+	gint        max_timeout;
+	GHashTable *allowed_hints;
+} GooroomNotifyPolicy;
+
+/* NULL or "" is $XDG_CONFIG_HOME/gooroom-notifyd/policy; the file is
+ * read again whenever it changes */
+void                       gooroom_notify_policy_set_file    (const gchar *path);
+
+/* NULL when no policy applies to the application */
+const GooroomNotifyPolicy *gooroom_notify_policy_lookup      (const gchar *app_name);
+
+gboolean                   gooroom_notify_policy_allows_hint (const GooroomNotifyPolicy *policy,
+                                                              const gchar               *hint);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_POLICY_H__ */
@@ -0,0 +1,204 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Notification records are carved out of fixed chunks, so a record never
+ * moves once handed out and freed records are reused before a new chunk is
+ * taken. Strings shared between notifications are interned, the summary,
+ * body and icon location of a record go in a single block. Only themed icon
+ * names are interned, a path or URI rarely comes back. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gooroom-notify-intern.h"
+#include "gooroom-notify-record.h"
+
+#define RECORD_CHUNK_SIZE  64
+
+static GPtrArray           *chunks = NULL;
+static GooroomNotifyRecord *free_list = NULL;
+
+
+/* the way GooroomNotifyWindow tells them from locations */
+static gboolean
+gooroom_notify_record_is_icon_name (const gchar *icon)
+{
+	gchar *scheme;
+
+	if (g_path_is_absolute (icon))
+		return FALSE;
+
+	scheme = g_uri_parse_scheme (icon);
+	g_free (scheme);
+
+	return scheme == NULL;
+}
+
+static void
+gooroom_notify_record_grow (void)
+{
+	GooroomNotifyRecord *chunk;
+	gint i;
+
+	if (!chunks)
+		chunks = g_ptr_array_new ();
+
+	chunk = g_new0 (GooroomNotifyRecord, RECORD_CHUNK_SIZE);
+	g_ptr_array_add (chunks, chunk);
+
+	for (i = RECORD_CHUNK_SIZE - 1; i >= 0; i--) {
+		chunk[i].next_free = free_list;
+		free_list = &chunk[i];
+	}
+}
+
+GooroomNotifyRecord *
+gooroom_notify_record_new (guint32 id)
+{
+	GooroomNotifyRecord *record;
+
+	if (!free_list)
+		gooroom_notify_record_grow ();
+
+	record = free_list;
+	free_list = record->next_free;
+
+	memset (record, 0, sizeof (GooroomNotifyRecord));
+	record->id = id;
+	record->timestamp = g_get_real_time ();
+
+	return record;
+}
+
+void
+gooroom_notify_record_free (GooroomNotifyRecord *record)
+{
+	if (!record)
+		return;
+
+	if (record->window)
+		gtk_widget_destroy (record->window);
+	if (record->icon_data)
+		g_variant_unref (record->icon_data);
+	if (record->snapshot)
+		g_variant_unref (record->snapshot);
+
+	gooroom_notify_intern_unref (record->app_name);
+	if (!record->icon_offset)
+		gooroom_notify_intern_unref (record->icon);
+	gooroom_notify_intern_unref (record->sender);
+	g_free (record->text);
+	g_strfreev (record->actions);
+
+	memset (record, 0, sizeof (GooroomNotifyRecord));
+	record->next_free = free_list;
+	free_list = record;
+}
+
+void
+gooroom_notify_record_set_strings (GooroomNotifyRecord *record,
+                                   const gchar         *app_name,
+                                   const gchar         *summary,
+                                   const gchar         *body,
+                                   const gchar         *icon,
+                                   const gchar         *sender)
+{
+	const gchar *old_app_name = record->app_name;
+	const gchar *old_icon = record->icon_offset ? NULL : record->icon;
+	const gchar *old_sender = record->sender;
+	gsize summary_len, body_len, icon_len = 0;
+	guint32 icon_offset = 0;
+	gchar *text;
+
+	summary_len = summary ? strlen (summary) : 0;
+	body_len = body ? strlen (body) : 0;
+
+	if (icon && !gooroom_notify_record_is_icon_name (icon)) {
+		icon_offset = summary_len + body_len + 2;
+		icon_len = strlen (icon) + 1;
+	}
+
+	text = g_malloc (summary_len + body_len + 2 + icon_len);
+	memcpy (text, summary ? summary : "", summary_len + 1);
+	memcpy (text + summary_len + 1, body ? body : "", body_len + 1);
+	if (icon_offset)
+		memcpy (text + icon_offset, icon, icon_len);
+
+	/* the new strings may be the old ones, which go last */
+	record->app_name = gooroom_notify_intern_ref (app_name);
+	record->icon = icon_offset ? text + icon_offset : gooroom_notify_intern_ref (icon);
+	record->sender = gooroom_notify_intern_ref (sender);
+
+	gooroom_notify_intern_unref (old_app_name);
+	gooroom_notify_intern_unref (old_icon);
+	gooroom_notify_intern_unref (old_sender);
+
+	g_free (record->text);
+	record->text = text;
+	record->body_offset = summary_len + 1;
+	record->icon_offset = icon_offset;
+}
+
+gsize
+gooroom_notify_record_get_size (GooroomNotifyRecord *record)
+{
+	gsize size = sizeof (GooroomNotifyRecord);
+	gint i;
+
+	if (record->text)
+		size += record->body_offset + strlen (record->text + record->body_offset) + 1;
+	if (record->icon_offset)
+		size += strlen (record->icon) + 1;
+
+	if (record->actions) {
+		for (i = 0; record->actions[i]; i++)
+			size += sizeof (gchar *) + strlen (record->actions[i]) + 1;
+	}
+
+	if (record->icon_data)
+		size += g_variant_get_size (record->icon_data);
+
+	return size;
+}
+
+void
+gooroom_notify_record_set_actions (GooroomNotifyRecord  *record,
+                                   const gchar         **actions)
+{
+	g_strfreev (record->actions);
+	record->actions = (actions && actions[0]) ? g_strdupv ((gchar **)actions) : NULL;
+}
+
+void
+gooroom_notify_record_set_icon_data (GooroomNotifyRecord *record,
+                                     GVariant            *icon_data)
+{
+	if (icon_data)
+		g_variant_ref (icon_data);
+	if (record->icon_data)
+		g_variant_unref (record->icon_data);
+	if (record->snapshot) {
+		g_variant_unref (record->snapshot);
+		record->snapshot = NULL;
+	}
+	record->icon_data = icon_data;
+}
@@ -0,0 +1,111 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_RECORD_H__
+#define __GOOROOM_NOTIFY_RECORD_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+	GOOROOM_NOTIFY_RECORD_QUEUED = 0,
+	GOOROOM_NOTIFY_RECORD_SHOWN,
+} GooroomNotifyRecordState;
+
+typedef enum
+{
+	GOOROOM_NOTIFY_RECORD_ICON_ONLY = 1 << 0,
+	GOOROOM_NOTIFY_RECORD_TRANSIENT = 1 << 1,
+	GOOROOM_NOTIFY_RECORD_HAS_VALUE = 1 << 2,
+} GooroomNotifyRecordFlags;
+
+/* everything the daemon knows about a notification; the window exists only
+ * while the notification is on screen */
+typedef struct _GooroomNotifyRecord GooroomNotifyRecord;
+struct _GooroomNotifyRecord
+{
+	guint32     id;
+	guint8      state;
+	guint8      urgency;
+	guint8      flags;
+	gint32      expire_timeout;
+	gint32      value;
+	/* what it was counted for while held back by "Do not disturb", 0 when
+	 * it is not */
+	guint32     deferred_size;
+	gint64      timestamp;
+
+	/* interned, the same app or sender gives the same pointer; so is the
+	 * icon when it is a themed icon name, a location is kept in text */
+	const gchar *app_name;
+	const gchar *icon;
+	const gchar *sender;
+
+	/* summary, body and an icon location, packed one after the other */
+	gchar      *text;
+	guint32     body_offset;
+	guint32     icon_offset;    /* 0 for an interned icon */
+
+	gchar     **actions;
+	GVariant   *icon_data;
+
+	/* its entry in GetActiveNotifications, until it changes */
+	GVariant   *snapshot;
+
+	GtkWidget  *window;
+	gpointer    owner;
+
+	GooroomNotifyRecord *next_free;
+};
+
+GooroomNotifyRecord *gooroom_notify_record_new         (guint32              id);
+void                 gooroom_notify_record_free        (GooroomNotifyRecord *record);
+
+void                 gooroom_notify_record_set_strings (GooroomNotifyRecord *record,
+                                                        const gchar         *app_name,
+                                                        const gchar         *summary,
+                                                        const gchar         *body,
+                                                        const gchar         *icon,
+                                                        const gchar         *sender);
+
+static inline const gchar *
+gooroom_notify_record_get_summary (GooroomNotifyRecord *record)
+{
+	return record->text;
+}
+
+static inline const gchar *
+gooroom_notify_record_get_body (GooroomNotifyRecord *record)
+{
+	return record->text ? record->text + record->body_offset : NULL;
+}
+
+/* roughly the memory it holds, interned strings left out */
+gsize                gooroom_notify_record_get_size    (GooroomNotifyRecord *record);
+
+void                 gooroom_notify_record_set_actions   (GooroomNotifyRecord  *record,
+                                                          const gchar         **actions);
+void                 gooroom_notify_record_set_icon_data (GooroomNotifyRecord  *record,
+                                                          GVariant             *icon_data);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_RECORD_H__ */
@@ -0,0 +1,379 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* All expiration deadlines live in one hashed timer wheel: a timer goes to
+ * the slot of its deadline tick, so arming, cancelling, pausing and resuming
+ * are all constant time. A single GSource wakes up at the earliest deadline;
+ * only then are the slots that have passed swept and the next deadline
+ * looked up again. Deadlines further away than one turn of the wheel simply
+ * share a slot with nearer ones and stay put until their own time comes. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "gooroom-notify-timer.h"
+
+/* in microseconds, the resolution of g_get_monotonic_time () */
+#define TIMER_TICK     (10 * G_TIME_SPAN_MILLISECOND)
+#define TIMER_N_SLOTS  256
+
+typedef enum
+{
+	TIMER_STATE_ARMED,
+	TIMER_STATE_PAUSED,
+	TIMER_STATE_DUE,
+	TIMER_STATE_CANCELLED,
+} GooroomNotifyTimerState;
+
+typedef struct
+{
+	guint                    id;
+	GooroomNotifyTimerState  state;
+	gint64                   deadline;
+	gint64                   remaining;
+	GooroomNotifyTimerFunc   func;
+	gpointer                 user_data;
+	GQueue                  *slot;
+	GList                    link;
+} GooroomNotifyTimer;
+
+static GQueue      slots[TIMER_N_SLOTS];
+static GHashTable *timers = NULL;
+static GSource    *source = NULL;
+static gint64      last_tick = 0;
+static guint       last_timer_id = 0;
+static gboolean    coarse = FALSE;
+static gint64      suspended_since = 0;
+static guint64     wakeups = 0;
+
+
+static inline GQueue *
+gooroom_notify_timer_slot (gint64 tick)
+{
+	return &slots[tick % TIMER_N_SLOTS];
+}
+
+static void
+gooroom_notify_timer_link (GooroomNotifyTimer *timer)
+{
+	gint64 ready_time;
+
+	if (coarse)
+		timer->deadline = (timer->deadline + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC * G_USEC_PER_SEC;
+
+	/* a deadline in the past belongs to the slot being swept next */
+	timer->slot = gooroom_notify_timer_slot (MAX (timer->deadline / TIMER_TICK, last_tick));
+	g_queue_push_tail_link (timer->slot, &timer->link);
+	timer->state = TIMER_STATE_ARMED;
+
+	if (suspended_since)
+		return;
+
+	ready_time = g_source_get_ready_time (source);
+	if (ready_time < 0 || timer->deadline < ready_time)
+		g_source_set_ready_time (source, timer->deadline);
+}
+
+static void
+gooroom_notify_timer_unlink (GooroomNotifyTimer *timer)
+{
+	/* a cancelled timer only ever wakes the source up for nothing,
+	 * so the ready time is left alone */
+	g_queue_unlink (timer->slot, &timer->link);
+	timer->slot = NULL;
+}
+
+static gint64
+gooroom_notify_timer_next_deadline (void)
+{
+	gint64 tick, next = G_MAXINT64;
+	guint i;
+
+	/* once a slot is passed that holds something due within its own tick,
+	 * no later slot can hold anything earlier */
+	for (i = 0, tick = last_tick; i < TIMER_N_SLOTS; i++, tick++) {
+		GList *l;
+
+		for (l = gooroom_notify_timer_slot (tick)->head; l; l = l->next) {
+			GooroomNotifyTimer *timer = l->data;
+			next = MIN (next, timer->deadline);
+		}
+
+		if (next < (tick + 1) * TIMER_TICK)
+			break;
+	}
+
+	return next;
+}
+
+static void
+gooroom_notify_timer_update_ready_time (void)
+{
+	gint64 next;
+
+	if (suspended_since) {
+		g_source_set_ready_time (source, -1);
+		return;
+	}
+
+	next = gooroom_notify_timer_next_deadline ();
+	g_source_set_ready_time (source, next == G_MAXINT64 ? -1 : next);
+}
+
+static gboolean
+gooroom_notify_timer_dispatch (GSource     *src,
+                               GSourceFunc  callback,
+                               gpointer     user_data)
+{
+	GQueue due = G_QUEUE_INIT;
+	gint64 now, now_tick, tick;
+	GooroomNotifyTimer *timer;
+
+	wakeups++;
+
+	now = g_get_monotonic_time ();
+	now_tick = now / TIMER_TICK;
+
+	/* after a long sleep every slot has passed once, sweep each only once */
+	tick = MAX (last_tick, now_tick - TIMER_N_SLOTS + 1);
+
+	for (; tick <= now_tick; tick++) {
+		GQueue *slot = gooroom_notify_timer_slot (tick);
+		GList *l = slot->head;
+
+		while (l) {
+			GList *next_link = l->next;
+
+			timer = l->data;
+			if (timer->deadline <= now) {
+				g_queue_unlink (slot, l);
+				g_queue_push_tail_link (&due, l);
+				timer->slot = NULL;
+				timer->state = TIMER_STATE_DUE;
+			}
+			l = next_link;
+		}
+	}
+
+	/* timers of a future turn of the wheel stay in the last slot swept */
+	last_tick = now_tick;
+
+	/* callbacks may arm and cancel timers, a due one cancelled by an
+	 * earlier callback is skipped */
+	while ((timer = g_queue_pop_head (&due))) {
+		if (timer->state == TIMER_STATE_DUE)
+			timer->func (timer->user_data);
+		g_hash_table_remove (timers, GUINT_TO_POINTER (timer->id));
+	}
+
+	gooroom_notify_timer_update_ready_time ();
+
+	return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs gooroom_notify_timer_funcs = {
+	NULL,
+	NULL,
+	gooroom_notify_timer_dispatch,
+	NULL,
+};
+
+static void
+gooroom_notify_timer_ensure_source (void)
+{
+	if (source)
+		return;
+
+	timers = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	last_tick = g_get_monotonic_time () / TIMER_TICK;
+
+	source = g_source_new (&gooroom_notify_timer_funcs, sizeof (GSource));
+	g_source_set_name (source, "[gooroom-notifyd] expiration timers");
+	g_source_set_ready_time (source, -1);
+	g_source_attach (source, NULL);
+}
+
+static inline GooroomNotifyTimer *
+gooroom_notify_timer_lookup (guint id)
+{
+	if (!timers || id == 0)
+		return NULL;
+
+	return g_hash_table_lookup (timers, GUINT_TO_POINTER (id));
+}
+
+guint
+gooroom_notify_timer_add (guint                  timeout,
+                          GooroomNotifyTimerFunc func,
+                          gpointer               user_data)
+{
+	GooroomNotifyTimer *timer;
+
+	g_return_val_if_fail (func != NULL, 0);
+
+	gooroom_notify_timer_ensure_source ();
+
+	timer = g_new0 (GooroomNotifyTimer, 1);
+	do {
+		timer->id = ++last_timer_id;
+	} while (timer->id == 0 || g_hash_table_contains (timers, GUINT_TO_POINTER (timer->id)));
+
+	timer->deadline = g_get_monotonic_time () + (gint64) timeout * G_TIME_SPAN_MILLISECOND;
+	timer->func = func;
+	timer->user_data = user_data;
+	timer->link.data = timer;
+
+	g_hash_table_insert (timers, GUINT_TO_POINTER (timer->id), timer);
+	gooroom_notify_timer_link (timer);
+
+	return timer->id;
+}
+
+void
+gooroom_notify_timer_cancel (guint id)
+{
+	GooroomNotifyTimer *timer = gooroom_notify_timer_lookup (id);
+
+	if (!timer)
+		return;
+
+	switch (timer->state) {
+		case TIMER_STATE_ARMED:
+			gooroom_notify_timer_unlink (timer);
+			break;
+		case TIMER_STATE_DUE:
+		case TIMER_STATE_CANCELLED:
+			/* still queued in the dispatch, which frees it */
+			timer->state = TIMER_STATE_CANCELLED;
+			return;
+		case TIMER_STATE_PAUSED:
+		default:
+			break;
+	}
+
+	g_hash_table_remove (timers, GUINT_TO_POINTER (id));
+}
+
+void
+gooroom_notify_timer_pause (guint id)
+{
+	GooroomNotifyTimer *timer = gooroom_notify_timer_lookup (id);
+
+	if (!timer || timer->state != TIMER_STATE_ARMED)
+		return;
+
+	gooroom_notify_timer_unlink (timer);
+	timer->remaining = MAX (timer->deadline - g_get_monotonic_time (), 0);
+	timer->state = TIMER_STATE_PAUSED;
+}
+
+void
+gooroom_notify_timer_resume (guint id)
+{
+	GooroomNotifyTimer *timer = gooroom_notify_timer_lookup (id);
+
+	if (!timer || timer->state != TIMER_STATE_PAUSED)
+		return;
+
+	timer->deadline = g_get_monotonic_time () + timer->remaining;
+	gooroom_notify_timer_link (timer);
+}
+
+gint64
+gooroom_notify_timer_get_remaining (guint id)
+{
+	GooroomNotifyTimer *timer = gooroom_notify_timer_lookup (id);
+	gint64 remaining;
+
+	if (!timer)
+		return -1;
+
+	switch (timer->state) {
+		case TIMER_STATE_ARMED:
+			/* the clock stands still for a suspended wheel */
+			remaining = timer->deadline - (suspended_since ? suspended_since : g_get_monotonic_time ());
+			break;
+		case TIMER_STATE_PAUSED:
+			remaining = timer->remaining;
+			break;
+		default:
+			remaining = 0;
+			break;
+	}
+
+	return (MAX (remaining, 0) + G_TIME_SPAN_MILLISECOND - 1) / G_TIME_SPAN_MILLISECOND;
+}
+
+void
+gooroom_notify_timer_set_coarse (gboolean enabled)
+{
+	/* only deadlines armed from now on are rounded */
+	coarse = !!enabled;
+}
+
+void
+gooroom_notify_timer_set_suspended (gboolean suspended)
+{
+	GHashTableIter iter;
+	gpointer value;
+	gint64 now, elapsed;
+
+	if (!!suspended == !!suspended_since)
+		return;
+
+	now = MAX (g_get_monotonic_time (), 1);
+
+	if (suspended) {
+		suspended_since = now;
+		if (source)
+			g_source_set_ready_time (source, -1);
+		return;
+	}
+
+	elapsed = now - suspended_since;
+	suspended_since = 0;
+
+	if (!source)
+		return;
+
+	/* the slots passed while suspended were never swept, every armed
+	 * timer moves on to its shifted deadline */
+	last_tick = now / TIMER_TICK;
+
+	g_hash_table_iter_init (&iter, timers);
+	while (g_hash_table_iter_next (&iter, NULL, &value)) {
+		GooroomNotifyTimer *timer = value;
+
+		if (timer->state != TIMER_STATE_ARMED)
+			continue;
+
+		gooroom_notify_timer_unlink (timer);
+		timer->deadline += elapsed;
+		gooroom_notify_timer_link (timer);
+	}
+
+	gooroom_notify_timer_update_ready_time ();
+}
+
+guint64
+gooroom_notify_timer_get_wakeups (void)
+{
+	return wakeups;
+}
@@ -0,0 +1,53 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOOROOM_NOTIFY_TIMER_H__
+#define __GOOROOM_NOTIFY_TIMER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef void (*GooroomNotifyTimerFunc) (gpointer user_data);
+
+guint gooroom_notify_timer_add    (guint                  timeout,
+                                   GooroomNotifyTimerFunc func,
+                                   gpointer               user_data);
+
+void  gooroom_notify_timer_cancel (guint id);
+
+/* a paused timer keeps the time it had left and gets it back on resume */
+void  gooroom_notify_timer_pause  (guint id);
+void  gooroom_notify_timer_resume (guint id);
+
+/* in milliseconds, -1 for an unknown id */
+gint64 gooroom_notify_timer_get_remaining (guint id);
+
+/* round deadlines up to whole seconds so that they share wakeups */
+void  gooroom_notify_timer_set_coarse    (gboolean enabled);
+
+/* a suspended wheel does not wake up, the time spent suspended is
+ * added to every armed deadline on resume */
+void  gooroom_notify_timer_set_suspended (gboolean suspended);
+
+guint64 gooroom_notify_timer_get_wakeups (void);
+
+G_END_DECLS
+
+#endif  /* __GOOROOM_NOTIFY_TIMER_H__ */
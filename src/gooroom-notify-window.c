@@ -29,6 +29,15 @@
 #include <math.h>
 
 #include "gooroom-notify-window.h"
+#include "common.h"
+#include "gooroom-notify-animation.h"
+#include "gooroom-notify-icon-atlas.h"
+#include "gooroom-notify-icon-cache.h"
+#include "gooroom-notify-icon-scale.h"
+#include "gooroom-notify-intern.h"
+#include "gooroom-notify-layout-cache.h"
+#include "gooroom-notify-overlay.h"
+#include "gooroom-notify-timer.h"
 #include "gooroom-notify-enum-types.h"
 
 #define DEFAULT_EXPIRE_TIMEOUT 10000
@@ -36,7 +45,8 @@
 #define DEFAULT_DO_FADEOUT     TRUE
 #define DEFAULT_DO_SLIDEOUT    FALSE
 #define FADE_TIME              800
-#define FADE_CHANGE_TIMEOUT    50
+#define SLIDE_TIME             (FADE_TIME / 2)
+#define SLIDE_DISTANCE         160
 #define DEFAULT_RADIUS         10
 
 struct _GooroomNotifyWindowPrivate
@@ -47,7 +57,8 @@ struct _GooroomNotifyWindowPrivate
 	guint expire_timeout;
 
 	gdouble normal_opacity;
-	gint original_x, original_y;
+	gdouble paint_opacity;
+	gint slide_offset;
 
 	guint32 icon_only:1,
             has_summary_text:1,
@@ -63,11 +74,27 @@ struct _GooroomNotifyWindowPrivate
 	GtkWidget *body;
 	GtkWidget *button_box;
 
-	guint64 expire_start_timestamp;
+	/* set when the notification is drawn by an overlay instead of
+	 * being mapped on its own */
+	GtkWidget *overlay;
+
+	/* what the icon was rendered from, to render it again for a monitor
+	 * with another scale factor */
+	gint icon_scale;
+	const gchar *icon_name;
+	gchar *icon_location;
+	GVariant *icon_data;
+	GdkPixbuf *icon_pixbuf;
+
+	/* pending load of an icon file */
+	GCancellable *icon_cancellable;
+
 	guint expire_id;
+	gboolean expire_paused;
+	/* the X window is being created again, its timers carry on */
+	gboolean recreating;
 	guint fade_id;
-	guint op_change_steps;
-	gdouble op_change_delta;
+	gboolean fade_transparent;
 	gboolean do_fadeout;
 	gboolean do_slideout;
 	GtkCornerType notify_location;
@@ -84,14 +111,18 @@ static guint signals[N_SIGS] = { 0, };
 
 
 static void gooroom_notify_window_finalize(GObject *object);
+static void gooroom_notify_window_destroy(GtkWidget *widget);
 static void gooroom_notify_window_realize(GtkWidget *widget);
 static void gooroom_notify_window_unrealize(GtkWidget *widget);
 static gboolean gooroom_notify_window_enter_leave(GtkWidget *widget, GdkEventCrossing *evt);
 static gboolean gooroom_notify_window_button_release(GtkWidget *widget, GdkEventButton *evt);
 static gboolean gooroom_notify_window_configure_event(GtkWidget *widget, GdkEventConfigure *evt);
-static gboolean gooroom_notify_window_expire_timeout(gpointer data);
-static gboolean gooroom_notify_window_fade_timeout(gpointer data);
+static gboolean gooroom_notify_window_draw(GtkWidget *widget, cairo_t *cr);
+static void gooroom_notify_window_expire_timeout (gpointer data);
+static void gooroom_notify_window_fade_step(GtkWidget *widget, gdouble progress, gpointer user_data);
+static void gooroom_notify_window_fade_done(GtkWidget *widget, gpointer user_data);
 static void gooroom_notify_window_button_clicked(GtkWidget *widget, gpointer user_data);
+static void gooroom_notify_window_scale_factor_changed(GObject *object, GParamSpec *pspec, gpointer user_data);
 
 
 
@@ -99,40 +130,116 @@ G_DEFINE_TYPE_WITH_PRIVATE (GooroomNotifyWindow, gooroom_notify_window, GTK_TYPE
 
 
 
+static void
+gooroom_notify_window_set_paint_opacity (GooroomNotifyWindow *window,
+                                         gdouble              opacity)
+{
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	priv->paint_opacity = opacity;
+
+	if (priv->overlay)
+		gooroom_notify_overlay_damage (GOOROOM_NOTIFY_OVERLAY (priv->overlay), window);
+	else
+		gtk_widget_set_opacity (GTK_WIDGET (window), opacity);
+}
+
+/* TRUE once the notification is on its way to the screen, either as its
+ * own window or inside an overlay */
+static inline gboolean
+gooroom_notify_window_is_live (GooroomNotifyWindow *window)
+{
+	return window->priv->overlay || gtk_widget_get_realized (GTK_WIDGET (window));
+}
+
+static void
+gooroom_notify_window_stop_expiration (GooroomNotifyWindow *window)
+{
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (priv->fade_id) {
+		gooroom_notify_animation_cancel (priv->fade_id);
+		priv->fade_id = 0;
+	}
+
+	if (priv->expire_id) {
+		gooroom_notify_timer_cancel (priv->expire_id);
+		priv->expire_id = 0;
+		priv->expire_paused = FALSE;
+	}
+}
+
 static void
 gooroom_notify_window_start_expiration (GooroomNotifyWindow *window)
 {
 	GooroomNotifyWindowPrivate *priv = window->priv;
 
 	if(priv->expire_timeout) {
-		gint64 ct;
 		guint timeout;
-		gboolean fade_transparent;
 
-		ct = g_get_real_time ();
-
-		fade_transparent = gdk_screen_is_composited (gtk_window_get_screen (GTK_WINDOW (window)));
-
-		if (!fade_transparent)
+		if (!priv->fade_transparent)
 			timeout = priv->expire_timeout;
 		else if (priv->expire_timeout > FADE_TIME)
 			timeout = priv->expire_timeout - FADE_TIME;
 		else
 			timeout = FADE_TIME;
 
-		priv->expire_start_timestamp = ct / 1000;
-		priv->expire_id = g_timeout_add (timeout, gooroom_notify_window_expire_timeout, window);
+		priv->expire_id = gooroom_notify_timer_add (timeout, gooroom_notify_window_expire_timeout, window);
+		priv->expire_paused = FALSE;
 	}
 
-	gtk_widget_set_opacity(GTK_WIDGET(window), priv->normal_opacity);
+	gooroom_notify_window_set_paint_opacity (window, priv->normal_opacity);
+}
+
+static void
+gooroom_notify_window_cancel_icon_load (GooroomNotifyWindow *window)
+{
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (priv->icon_cancellable) {
+		g_cancellable_cancel (priv->icon_cancellable);
+		g_clear_object (&priv->icon_cancellable);
+	}
+}
+
+static void
+gooroom_notify_window_clear_icon_source (GooroomNotifyWindow *window)
+{
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	gooroom_notify_window_cancel_icon_load (window);
+
+	gooroom_notify_intern_unref (priv->icon_name);
+	priv->icon_name = NULL;
+	g_clear_pointer (&priv->icon_location, g_free);
+	g_clear_pointer (&priv->icon_data, g_variant_unref);
+	g_clear_object (&priv->icon_pixbuf);
 }
 
 static void
 gooroom_notify_window_finalize (GObject *object)
 {
+	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (object);
+
+	gooroom_notify_window_clear_icon_source (window);
+
 	G_OBJECT_CLASS (gooroom_notify_window_parent_class)->finalize (object);
 }
 
+static void
+gooroom_notify_window_destroy (GtkWidget *widget)
+{
+	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (widget);
+
+	/* windows drawn by an overlay are never realized, so unrealize is not
+	 * enough to get rid of their timers */
+	gooroom_notify_window_stop_expiration (window);
+	gooroom_notify_window_cancel_icon_load (window);
+	window->priv->overlay = NULL;
+
+	GTK_WIDGET_CLASS (gooroom_notify_window_parent_class)->destroy (widget);
+}
+
 static void
 gooroom_notify_window_realize (GtkWidget *widget)
 {
@@ -144,26 +251,42 @@ gooroom_notify_window_realize (GtkWidget *widget)
                               GDK_WINDOW_TYPE_HINT_NOTIFICATION);
 	gdk_window_set_override_redirect (gtk_widget_get_window (widget), TRUE);
 
-	gooroom_notify_window_start_expiration (window);
+	if (window->priv->recreating)
+		gooroom_notify_window_set_paint_opacity (window, window->priv->normal_opacity);
+	else
+		gooroom_notify_window_start_expiration (window);
 }
 
 static void
 gooroom_notify_window_unrealize (GtkWidget *widget)
 {
 	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (widget);
+
+	if (!window->priv->recreating)
+		gooroom_notify_window_stop_expiration (window);
+
+	GTK_WIDGET_CLASS (gooroom_notify_window_parent_class)->unrealize(widget);
+}
+
+/* Puts a sliding-out window back into place. The slide only moves the
+ * contents inside the window, so there is no X window to move back. */
+static void
+gooroom_notify_window_reset_slide (GooroomNotifyWindow *window)
+{
 	GooroomNotifyWindowPrivate *priv = window->priv;
 
-	if (priv->fade_id) {
-		g_source_remove (priv->fade_id);
-		priv->fade_id = 0;
-	}
+	if (!priv->do_slideout)
+		return;
 
-	if (priv->expire_id) {
-		g_source_remove (priv->expire_id);
-		priv->expire_id = 0;
+	priv->slide_offset = 0;
+
+	if (priv->overlay) {
+		gooroom_notify_overlay_damage (GOOROOM_NOTIFY_OVERLAY (priv->overlay), window);
+		return;
 	}
 
-	GTK_WIDGET_CLASS (gooroom_notify_window_parent_class)->unrealize(widget);
+	gtk_widget_input_shape_combine_region (GTK_WIDGET (window), NULL);
+	gtk_widget_queue_draw (GTK_WIDGET (window));
 }
 
 static inline int
@@ -198,24 +321,10 @@ gooroom_notify_window_enter_leave (GtkWidget *widget,
 
 	if (evt->type == GDK_ENTER_NOTIFY) {
 		gtk_style_context_set_state (style_context, state_flags | GTK_STATE_FLAG_PRELIGHT);
-
-		if (priv->expire_timeout) {
-			if (priv->expire_id) {
-				g_source_remove (priv->expire_id);
-				priv->expire_id = 0;
-			}
-			if (priv->fade_id) {
-				g_source_remove (priv->fade_id);
-				priv->fade_id = 0;
-				/* reset the sliding-out window to its original position */
-				if (priv->do_slideout)
-					gtk_window_move (GTK_WINDOW (window), priv->original_x, priv->original_y);
-			}
-		}
+		gooroom_notify_window_set_hovered (window, TRUE);
 	} else if (evt->type == GDK_LEAVE_NOTIFY && evt->detail != GDK_NOTIFY_INFERIOR) {
 		gtk_style_context_set_state (style_context, state_flags & ~GTK_STATE_FLAG_PRELIGHT);
-
-		gooroom_notify_window_start_expiration (window);
+		gooroom_notify_window_set_hovered (window, FALSE);
 	}
 
 	return FALSE;
@@ -272,74 +381,110 @@ gooroom_notify_window_configure_event (GtkWidget *widget,
 }
 
 static gboolean
+gooroom_notify_window_draw (GtkWidget *widget,
+                            cairo_t   *cr)
+{
+	gboolean ret;
+	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (widget);
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (priv->slide_offset == 0)
+		return GTK_WIDGET_CLASS (gooroom_notify_window_parent_class)->draw (widget, cr);
+
+	/* the window itself stays put, only its contents slide towards the
+	 * screen edge and get clipped by the window bounds */
+	cairo_save (cr);
+	cairo_translate (cr, priv->slide_offset, 0);
+	ret = GTK_WIDGET_CLASS (gooroom_notify_window_parent_class)->draw (widget, cr);
+	cairo_restore (cr);
+
+	return ret;
+}
+
+static void
 gooroom_notify_window_expire_timeout (gpointer user_data)
 {
-	gboolean          fade_transparent;
-	gint              animation_timeout;
 	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (user_data);
 	GooroomNotifyWindowPrivate *priv = window->priv;
 
 	priv->expire_id = 0;
 
-	fade_transparent = gdk_screen_is_composited (gtk_window_get_screen (GTK_WINDOW (window)));
+	if(priv->fade_transparent && priv->do_fadeout) {
+		/* an overlay is mapped while the notification window is not,
+		 * so its frame clock has to drive the animation */
+		GtkWidget *clock_widget = priv->overlay ? priv->overlay : GTK_WIDGET (window);
 
-	if(fade_transparent && priv->do_fadeout) {
-		/* remember the original position of the window before we slide it out */
 		if (priv->do_slideout) {
-			gtk_window_get_position (GTK_WINDOW (window), &priv->original_x, &priv->original_y);
-			animation_timeout = FADE_CHANGE_TIMEOUT / 2;
+			if (!priv->overlay) {
+				cairo_region_t *empty;
+
+				/* let the pointer through while the contents leave the window,
+				 * this is the only X request the slide needs */
+				empty = cairo_region_create ();
+				gtk_widget_input_shape_combine_region (GTK_WIDGET (window), empty);
+				cairo_region_destroy (empty);
+			}
+
+			priv->fade_id = gooroom_notify_animation_start (clock_widget,
+			                                                SLIDE_TIME,
+			                                                GOOROOM_NOTIFY_EASING_EASE_IN_CUBIC,
+			                                                gooroom_notify_window_fade_step,
+			                                                gooroom_notify_window_fade_done,
+			                                                window);
+		} else {
+			priv->fade_id = gooroom_notify_animation_start (clock_widget,
+			                                                FADE_TIME,
+			                                                GOOROOM_NOTIFY_EASING_EASE_IN_OUT_CUBIC,
+			                                                gooroom_notify_window_fade_step,
+			                                                gooroom_notify_window_fade_done,
+			                                                window);
 		}
-		else
-			animation_timeout = FADE_CHANGE_TIMEOUT;
-		priv->fade_id = g_timeout_add (animation_timeout, gooroom_notify_window_fade_timeout, window);
 	} else {
 		/* it might be 800ms early, but that's ok */
 		g_signal_emit (G_OBJECT(window), signals[SIG_CLOSED], 0,
                        GOOROOM_NOTIFY_CLOSE_REASON_EXPIRED);
     }
-
-    return FALSE;
 }
 
-static gboolean
-gooroom_notify_window_fade_timeout (gpointer user_data)
+static void
+gooroom_notify_window_fade_step (GtkWidget *widget,
+                                 gdouble    progress,
+                                 gpointer   user_data)
 {
-	gdouble op;
-	gint x, y;
+	gint offset;
 	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (user_data);
 	GooroomNotifyWindowPrivate *priv = window->priv;
 
-    /* slide out animation */
+	/* slide out animation */
 	if (priv->do_slideout) {
-		gtk_window_get_position (GTK_WINDOW (window), &x, &y);
-		if (priv->notify_location == GTK_CORNER_TOP_RIGHT ||
-            priv->notify_location == GTK_CORNER_BOTTOM_RIGHT)
-            x = x + 10;
-        else if (priv->notify_location == GTK_CORNER_TOP_LEFT ||
-                 priv->notify_location == GTK_CORNER_BOTTOM_LEFT)
-			x = x - 10;
-		else
+		offset = (gint)(MAX (SLIDE_DISTANCE, priv->geometry.width) * progress);
+		if (priv->notify_location == GTK_CORNER_TOP_LEFT ||
+            priv->notify_location == GTK_CORNER_BOTTOM_LEFT)
+			offset = -offset;
+		else if (priv->notify_location != GTK_CORNER_TOP_RIGHT &&
+                 priv->notify_location != GTK_CORNER_BOTTOM_RIGHT)
 			g_warning ("Invalid notify location: %d", priv->notify_location);
 
-		gtk_window_move (GTK_WINDOW (window), x, y);
+		if (offset != priv->slide_offset) {
+			priv->slide_offset = offset;
+			if (!priv->overlay)
+				gtk_widget_queue_draw (GTK_WIDGET (window));
+		}
 	}
 
 	/* fade-out animation */
-	op = gtk_widget_get_opacity (GTK_WIDGET (window));
-	op -= priv->op_change_delta;
-	if(op < 0.0)
-		op = 0.0;
-
-	gtk_widget_set_opacity (GTK_WIDGET (window), op);
+	gooroom_notify_window_set_paint_opacity (window, priv->normal_opacity * (1.0 - progress));
+}
 
-	if (op <= 0.0001) {
-		priv->fade_id = 0;
-		g_signal_emit (G_OBJECT (window), signals[SIG_CLOSED], 0,
-				GOOROOM_NOTIFY_CLOSE_REASON_EXPIRED);
-		return FALSE;
-	}
+static void
+gooroom_notify_window_fade_done (GtkWidget *widget,
+                                 gpointer   user_data)
+{
+	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (user_data);
 
-	return TRUE;
+	window->priv->fade_id = 0;
+	g_signal_emit (G_OBJECT (window), signals[SIG_CLOSED], 0,
+                   GOOROOM_NOTIFY_CLOSE_REASON_EXPIRED);
 }
 
 static void
@@ -354,9 +499,7 @@ gooroom_notify_window_button_clicked (GtkWidget *widget,
 	action_id = g_object_get_data (G_OBJECT(widget), "--action-id");
 	g_assert (action_id);
 
-	g_signal_emit (G_OBJECT (window), signals[SIG_ACTION_INVOKED], 0, action_id);
-	g_signal_emit (G_OBJECT (window), signals[SIG_CLOSED], 0,
-                   GOOROOM_NOTIFY_CLOSE_REASON_DISMISSED);
+	gooroom_notify_window_invoke_action (window, action_id);
 }
 
 static void
@@ -373,11 +516,16 @@ gooroom_notify_window_init (GooroomNotifyWindow *window)
 
 	priv->expire_timeout = DEFAULT_EXPIRE_TIMEOUT;
 	priv->normal_opacity = DEFAULT_NORMAL_OPACITY;
+	priv->paint_opacity = DEFAULT_NORMAL_OPACITY;
 	priv->do_fadeout = DEFAULT_DO_FADEOUT;
 	priv->do_slideout = DEFAULT_DO_SLIDEOUT;
 
 	gtk_widget_init_template (GTK_WIDGET (window));
 
+	priv->icon_scale = gtk_widget_get_scale_factor (GTK_WIDGET (window));
+	g_signal_connect (window, "notify::scale-factor",
+	                  G_CALLBACK (gooroom_notify_window_scale_factor_changed), NULL);
+
 	gtk_window_set_keep_above (GTK_WINDOW (window), TRUE);
 	gtk_window_stick (GTK_WINDOW (window));
 	gtk_window_set_decorated (GTK_WINDOW (window), FALSE);
@@ -389,13 +537,6 @@ gooroom_notify_window_init (GooroomNotifyWindow *window)
 	gtk_widget_set_app_paintable (GTK_WIDGET (window), TRUE);
 
 	screen = gtk_widget_get_screen (GTK_WIDGET (window));
-	if (gdk_screen_is_composited (screen)) {
-		GdkVisual *visual = gdk_screen_get_rgba_visual (screen);
-		if (visual == NULL)
-			visual = gdk_screen_get_system_visual (screen);
-
-		gtk_widget_set_visual (GTK_WIDGET (window), visual);
-	}
 
 	monitor = gdk_display_get_monitor_at_window (gtk_widget_get_display (GTK_WIDGET (window)),
                                                  gdk_screen_get_root_window (screen));
@@ -421,6 +562,7 @@ gooroom_notify_window_class_init (GooroomNotifyWindowClass *klass)
 
 	gobject_class->finalize = gooroom_notify_window_finalize;
 
+	widget_class->destroy = gooroom_notify_window_destroy;
 	widget_class->realize = gooroom_notify_window_realize;
 	widget_class->unrealize = gooroom_notify_window_unrealize;
 
@@ -429,6 +571,7 @@ gooroom_notify_window_class_init (GooroomNotifyWindowClass *klass)
 	widget_class->button_press_event = gooroom_notify_window_button_press;
 	widget_class->button_release_event = gooroom_notify_window_button_release;
 	widget_class->configure_event = gooroom_notify_window_configure_event;
+	widget_class->draw = gooroom_notify_window_draw;
 
 	gtk_widget_class_set_template_from_resource (widget_class,
 			"/kr/gooroom/notifyd/gooroom-notify-window.ui");
@@ -506,7 +649,10 @@ gooroom_notify_window_set_summary (GooroomNotifyWindow *window,
 {
 	GooroomNotifyWindowPrivate *priv = window->priv;
 
-	gtk_label_set_text (GTK_LABEL (priv->summary), summary);
+	/* keep the label's shaped layout when a replacement has the same text */
+	if (g_strcmp0 (gtk_label_get_label (GTK_LABEL (priv->summary)), summary) != 0)
+		gtk_label_set_text (GTK_LABEL (priv->summary), summary);
+
 	if (summary && *summary) {
 		gtk_widget_show (priv->summary);
 		priv->has_summary_text = TRUE;
@@ -525,18 +671,13 @@ gooroom_notify_window_set_body (GooroomNotifyWindow *window,
 {
 	GooroomNotifyWindowPrivate *priv = window->priv;
 
+	if (priv->has_body_text && g_strcmp0 (gtk_label_get_label (GTK_LABEL (priv->body)), body) == 0)
+		return;
+
 	if (body && *body) {
-        /* Try to set the body with markup and in case this fails (empty label)
-           fall back to escaping the whole string and showing it plainly.
-           This equals pango_parse_markup extended by checking for valid hyperlinks
-           (which is not supported by pango). */
+		/* the body is expected to come from notify_markup_sanitize (), so
+		 * it is parsed only once */
 		gtk_label_set_markup (GTK_LABEL (priv->body), body);
-		if (g_strcmp0 (gtk_label_get_text(GTK_LABEL (priv->body)), "") == 0 ) {
-			gchar *tmp;
-			tmp = g_markup_escape_text (body, -1);
-			gtk_label_set_text (GTK_LABEL (priv->body), body);
-			g_free (tmp);
-		}
 		gtk_widget_show (priv->body);
 		priv->has_body_text = TRUE;
 	} else {
@@ -575,41 +716,161 @@ gooroom_notify_window_get_last_monitor (GooroomNotifyWindow *window)
 	return window->priv->last_monitor;
 }
 
+static inline gint
+gooroom_notify_window_get_icon_size (void)
+{
+	gint w, h;
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_DND, &w, &h);
+
+	return MIN (w, h);
+}
+
+static void
+gooroom_notify_window_set_themed_icon (GooroomNotifyWindow *window,
+                                       const gchar         *icon_name)
+{
+	GIcon *icon;
+	cairo_surface_t *surface;
+
+	/* painted from the pages shared by all daemons on the host */
+	surface = gooroom_notify_icon_atlas_lookup (icon_name,
+	                                            gooroom_notify_window_get_icon_size (),
+	                                            window->priv->icon_scale);
+	if (surface) {
+		gtk_image_set_from_surface (GTK_IMAGE (window->priv->icon), surface);
+		cairo_surface_destroy (surface);
+		return;
+	}
+
+	icon = gooroom_notify_icon_cache_load_themed (icon_name);
+	gtk_image_set_from_gicon (GTK_IMAGE (window->priv->icon), icon, GTK_ICON_SIZE_DND);
+	g_object_unref (icon);
+}
+
+static void
+gooroom_notify_window_icon_changed (GooroomNotifyWindow *window)
+{
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (priv->overlay)
+		gooroom_notify_overlay_add (GOOROOM_NOTIFY_OVERLAY (priv->overlay), window);
+	else if (gtk_widget_get_realized (GTK_WIDGET (window)))
+		gtk_widget_queue_draw (GTK_WIDGET (window));
+}
+
+static void
+gooroom_notify_window_icon_loaded (GObject      *source_object,
+                                   GAsyncResult *result,
+                                   gpointer      user_data)
+{
+	cairo_surface_t *surface;
+	GError *error = NULL;
+	GooroomNotifyWindow *window = user_data;
+	GooroomNotifyWindowPrivate *priv;
+
+	surface = gooroom_notify_icon_cache_load_file_finish (result, &error);
+
+	/* the window may be gone already */
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free (error);
+		return;
+	}
+
+	priv = window->priv;
+	g_clear_object (&priv->icon_cancellable);
+
+	if (surface) {
+		gtk_image_set_from_surface (GTK_IMAGE (priv->icon), surface);
+		cairo_surface_destroy (surface);
+	} else {
+		/* keeps the layout the placeholder was measured with */
+		g_debug ("Failed to load icon: %s", error->message);
+		g_error_free (error);
+		gooroom_notify_window_set_themed_icon (window, "image-missing");
+	}
+
+	gooroom_notify_window_icon_changed (window);
+}
+
+/* Renders the icon from its source at priv->icon_scale. Themed icons that
+ * are not in the atlas are looked up at the right scale by GtkImage and the
+ * overlay themselves. */
+static void
+gooroom_notify_window_render_icon (GooroomNotifyWindow *window,
+                                   gboolean             initial)
+{
+	gint size;
+	cairo_surface_t *surface = NULL;
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	size = gooroom_notify_window_get_icon_size ();
+
+	if (priv->icon_location) {
+		gooroom_notify_window_cancel_icon_load (window);
+
+		/* files are decoded off the main loop, until then the last
+		 * decoded copy, the icon of the old scale or a placeholder is
+		 * shown */
+		surface = gooroom_notify_icon_cache_peek_file (priv->icon_location, size, priv->icon_scale);
+		if (!surface && initial)
+			gooroom_notify_window_set_themed_icon (window, "image-loading");
+
+		priv->icon_cancellable = g_cancellable_new ();
+		gooroom_notify_icon_cache_load_file_async (priv->icon_location, size, priv->icon_scale,
+		                                           priv->icon_cancellable,
+		                                           gooroom_notify_window_icon_loaded,
+		                                           window);
+	} else if (priv->icon_data) {
+		surface = gooroom_notify_icon_cache_load_image_data (priv->icon_data, size, priv->icon_scale);
+	} else if (priv->icon_name) {
+		gooroom_notify_window_set_themed_icon (window, priv->icon_name);
+	} else if (priv->icon_pixbuf) {
+		/* scaled and converted for cairo once, instead of on every draw */
+		surface = gooroom_notify_icon_scale_render (priv->icon_pixbuf, size, priv->icon_scale);
+	}
+
+	if (surface) {
+		gtk_image_set_from_surface (GTK_IMAGE (priv->icon), surface);
+		cairo_surface_destroy (surface);
+	}
+}
+
+static void
+gooroom_notify_window_scale_factor_changed (GObject    *object,
+                                            GParamSpec *pspec,
+                                            gpointer    user_data)
+{
+	GooroomNotifyWindow *window = GOOROOM_NOTIFY_WINDOW (object);
+
+	/* an overlaid window is told the scale of its overlay instead */
+	if (!window->priv->overlay)
+		gooroom_notify_window_set_icon_scale (window, gtk_widget_get_scale_factor (GTK_WIDGET (window)));
+}
+
 void
 gooroom_notify_window_set_icon_name (GooroomNotifyWindow *window,
                                      const gchar         *icon_name)
 {
-	gchar *filename;
 	gboolean icon_set = FALSE;
 	GooroomNotifyWindowPrivate *priv = window->priv;
 
+	gooroom_notify_window_clear_icon_source (window);
+
 	if (icon_name && *icon_name) {
-		gint w, h;
-		GdkPixbuf *pix = NULL;
-		GIcon *icon;
+		gchar *scheme = g_uri_parse_scheme (icon_name);
 
-		gtk_icon_size_lookup (GTK_ICON_SIZE_DND, &w, &h);
+		/* anything that is not an icon name is loaded by the icon cache,
+		 * which only accepts local files */
+		if (g_path_is_absolute (icon_name) || scheme)
+			priv->icon_location = g_strdup (icon_name);
+		else
+			priv->icon_name = gooroom_notify_intern_ref (icon_name);
 
-		if (g_path_is_absolute (icon_name)) {
-			pix = gdk_pixbuf_new_from_file_at_size (icon_name, w, h, NULL);
-		}
-		else if (g_str_has_prefix (icon_name, "file://")) {
-			filename = g_filename_from_uri (icon_name, NULL, NULL);
-			if (filename)
-				pix = gdk_pixbuf_new_from_file_at_size (filename, w, h, NULL);
-			g_free (filename);
-		}
-		else {
-			icon = g_themed_icon_new_with_default_fallbacks (icon_name);
-			gtk_image_set_from_gicon (GTK_IMAGE (priv->icon), icon, GTK_ICON_SIZE_DND);
-			icon_set = TRUE;
-		}
+		gooroom_notify_window_render_icon (window, TRUE);
+		g_free (scheme);
 
-		if (pix) {
-			gtk_image_set_from_pixbuf (GTK_IMAGE (priv->icon), pix);
-			g_object_unref (G_OBJECT (pix));
-			icon_set = TRUE;
-		}
+		icon_set = TRUE;
 	}
 
 	if (icon_set)
@@ -627,48 +888,92 @@ void
 gooroom_notify_window_set_icon_pixbuf (GooroomNotifyWindow *window,
                                        GdkPixbuf           *pixbuf)
 {
-	GdkPixbuf *p_free = NULL;
-	GooroomNotifyWindowPrivate *priv = window->priv;
-
 	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window)
                       && (!pixbuf || GDK_IS_PIXBUF (pixbuf)));
 
-	if (pixbuf) {
-		gint w, h, pw, ph;
+	if (!pixbuf) {
+		gooroom_notify_window_set_icon_surface (window, NULL);
+		return;
+	}
 
-		gtk_icon_size_lookup (GTK_ICON_SIZE_DND, &w, &h);
-		pw = gdk_pixbuf_get_width (pixbuf);
-		ph = gdk_pixbuf_get_height (pixbuf);
+	gooroom_notify_window_clear_icon_source (window);
+	window->priv->icon_pixbuf = g_object_ref (pixbuf);
 
-		if(w > h)
-			w = h;
-		if(pw > w || ph > w) {
-			gint nw, nh;
+	gooroom_notify_window_render_icon (window, TRUE);
 
-			if(pw > ph) {
-				nw = w;
-				nh = w * ((gdouble)ph/pw);
-			} else {
-				nw = w * ((gdouble)pw/ph);
-				nh = w;
-			}
+	gtk_widget_show (window->priv->icon_box);
 
-			pixbuf = p_free = gdk_pixbuf_scale_simple(pixbuf, nw, nh, GDK_INTERP_BILINEAR);
-		}
-	}
+	if (gtk_widget_get_realized (GTK_WIDGET (window)))
+		gtk_widget_queue_draw (GTK_WIDGET (window));
+}
+
+/* Takes image data as sent in the image-data and icon_data hints. Invalid
+ * data leaves the current icon in place. */
+void
+gooroom_notify_window_set_icon_data (GooroomNotifyWindow *window,
+                                     GVariant            *image_data)
+{
+	cairo_surface_t *surface;
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window) && image_data != NULL);
+
+	surface = gooroom_notify_icon_cache_load_image_data (image_data,
+	                                                     gooroom_notify_window_get_icon_size (),
+	                                                     priv->icon_scale);
+	if (!surface)
+		return;
 
-	gtk_image_set_from_pixbuf (GTK_IMAGE (priv->icon), pixbuf);
+	gooroom_notify_window_set_icon_surface (window, surface);
+	cairo_surface_destroy (surface);
 
-	if (pixbuf)
+	priv->icon_data = g_variant_ref (image_data);
+}
+
+/* the surface is expected to be at most GTK_ICON_SIZE_DND large, it is not
+ * rendered again for other scale factors */
+void
+gooroom_notify_window_set_icon_surface (GooroomNotifyWindow *window,
+                                        cairo_surface_t     *surface)
+{
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	gooroom_notify_window_clear_icon_source (window);
+
+	gtk_image_set_from_surface (GTK_IMAGE (priv->icon), surface);
+
+	if (surface)
 		gtk_widget_show (priv->icon_box);
 	else
 		gtk_widget_hide (priv->icon_box);
 
 	if (gtk_widget_get_realized (GTK_WIDGET (window)))
 		gtk_widget_queue_draw (GTK_WIDGET (window));
+}
+
+/* Icons are rendered for the scale factor of the monitor they are shown
+ * on, and only rendered again when that changes. */
+void
+gooroom_notify_window_set_icon_scale (GooroomNotifyWindow *window,
+                                      gint                 scale)
+{
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	scale = MAX (scale, 1);
+	if (scale == priv->icon_scale)
+		return;
+
+	priv->icon_scale = scale;
+
+	gooroom_notify_window_render_icon (window, FALSE);
 
-	if (p_free)
-		g_object_unref (G_OBJECT (p_free));
+	/* the overlay lays the window out again after this */
+	if (!priv->overlay && gtk_widget_get_realized (GTK_WIDGET (window)))
+		gtk_widget_queue_draw (GTK_WIDGET (window));
 }
 
 void
@@ -684,21 +989,53 @@ gooroom_notify_window_set_expire_timeout (GooroomNotifyWindow *window,
 	else
 		priv->expire_timeout = DEFAULT_EXPIRE_TIMEOUT;
 
-	if (gtk_widget_get_realized (GTK_WIDGET (window))) {
-		if (priv->expire_id) {
-			g_source_remove (priv->expire_id);
-			priv->expire_id = 0;
-		}
+	if (gooroom_notify_window_is_live (window)) {
+		gboolean paused = priv->expire_paused;
+
 		if (priv->fade_id) {
-			g_source_remove (priv->fade_id);
+			gooroom_notify_animation_cancel (priv->fade_id);
 			priv->fade_id = 0;
+			gooroom_notify_window_reset_slide (window);
 		}
-		gtk_widget_set_opacity (GTK_WIDGET (window), priv->normal_opacity);
+		gooroom_notify_window_stop_expiration (window);
 
 		gooroom_notify_window_start_expiration (window);
+
+		/* a hovered notification starts its new timeout once left */
+		if (paused && priv->expire_id) {
+			gooroom_notify_timer_pause (priv->expire_id);
+			priv->expire_paused = TRUE;
+		}
 	}
 }
 
+/* what is left of the expiration in milliseconds, the fade included;
+ * 0 when the notification does not expire */
+gint
+gooroom_notify_window_get_remaining_timeout (GooroomNotifyWindow *window)
+{
+	gint64 remaining;
+
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), 0);
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (!priv->expire_timeout)
+		return 0;
+
+	if (priv->fade_id)
+		return 1;
+
+	remaining = gooroom_notify_timer_get_remaining (priv->expire_id);
+	if (remaining < 0)
+		return priv->expire_timeout;
+
+	if (priv->fade_transparent)
+		remaining += FADE_TIME;
+
+	return (gint)CLAMP (remaining, 1, priv->expire_timeout);
+}
+
 void
 gooroom_notify_window_set_actions (GooroomNotifyWindow *window,
                                    const gchar         **actions)
@@ -741,8 +1078,8 @@ gooroom_notify_window_set_actions (GooroomNotifyWindow *window,
         btn = gtk_button_new ();
         gtk_button_set_relief (GTK_BUTTON (btn), GTK_RELIEF_NONE);
         g_object_set_data_full (G_OBJECT (btn), "--action-id",
-                                g_strdup (cur_action_id),
-                                (GDestroyNotify)g_free);
+                                (gpointer)gooroom_notify_intern_ref (cur_action_id),
+                                (GDestroyNotify)gooroom_notify_intern_unref);
 		gtk_widget_show (btn);
 		gtk_container_add (GTK_CONTAINER (priv->button_box), btn);
 		g_signal_connect (G_OBJECT (btn), "clicked",
@@ -765,6 +1102,84 @@ gooroom_notify_window_set_actions (GooroomNotifyWindow *window,
 		gtk_widget_queue_draw (GTK_WIDGET (window));
 }
 
+static void
+gooroom_notify_window_update_visual (GooroomNotifyWindow *window)
+{
+	GdkVisual *visual = NULL;
+	GdkScreen *screen = gtk_widget_get_screen (GTK_WIDGET (window));
+
+	if (window->priv->fade_transparent)
+		visual = gdk_screen_get_rgba_visual (screen);
+	if (visual == NULL)
+		visual = gdk_screen_get_system_visual (screen);
+
+	gtk_widget_set_visual (GTK_WIDGET (window), visual);
+}
+
+/* Follows the compositing state of the screen: with a compositor the window
+ * gets an RGBA visual and fades out, without one it closes right away. */
+void
+gooroom_notify_window_set_fade_transparent (GooroomNotifyWindow *window,
+                                            gboolean fade_transparent)
+{
+	gboolean mapped;
+	GtkWidget *widget;
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	fade_transparent = !!fade_transparent;
+	if (priv->fade_transparent == fade_transparent)
+		return;
+
+	priv->fade_transparent = fade_transparent;
+
+	if (priv->fade_id && !fade_transparent) {
+		/* a fade cannot be seen anymore, finish it off */
+		gooroom_notify_animation_cancel (priv->fade_id);
+		priv->fade_id = 0;
+		gooroom_notify_window_reset_slide (window);
+		priv->expire_id = gooroom_notify_timer_add (0, gooroom_notify_window_expire_timeout, window);
+	}
+
+	/* the overlay owns the visual of an overlaid notification */
+	if (priv->overlay)
+		return;
+
+	widget = GTK_WIDGET (window);
+
+	if (!gtk_widget_get_realized (widget)) {
+		gooroom_notify_window_update_visual (window);
+		return;
+	}
+
+	/* the visual of an X window is fixed, so the window is created again;
+	 * the time left and a pending close survive that */
+	mapped = gtk_widget_get_mapped (widget);
+
+	gooroom_notify_window_reset_slide (window);
+	priv->recreating = TRUE;
+	gtk_widget_hide (widget);
+	gtk_widget_unrealize (widget);
+
+	gooroom_notify_window_update_visual (window);
+
+	gtk_widget_realize (widget);
+	priv->recreating = FALSE;
+	gtk_window_move (GTK_WINDOW (window), priv->geometry.x, priv->geometry.y);
+	if (mapped)
+		gtk_widget_show (widget);
+}
+
+gboolean
+gooroom_notify_window_get_fade_transparent (GooroomNotifyWindow *window)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), FALSE);
+
+	return window->priv->fade_transparent;
+}
+
 void
 gooroom_notify_window_set_opacity (GooroomNotifyWindow *window, gdouble opacity)
 {
@@ -778,11 +1193,9 @@ gooroom_notify_window_set_opacity (GooroomNotifyWindow *window, gdouble opacity)
 		opacity = 0.0;
 
 	priv->normal_opacity = opacity;
-	priv->op_change_steps = FADE_TIME / FADE_CHANGE_TIMEOUT;
-	priv->op_change_delta = opacity / priv->op_change_steps;
 
-	if(gtk_widget_get_realized (GTK_WIDGET (window)) && priv->expire_id && !priv->fade_id)
-		gtk_widget_set_opacity (GTK_WIDGET (window), priv->normal_opacity);
+	if(gooroom_notify_window_is_live (window) && priv->expire_id && !priv->fade_id)
+		gooroom_notify_window_set_paint_opacity (window, priv->normal_opacity);
 }
 
 gdouble
@@ -933,3 +1346,255 @@ gooroom_notify_window_closed (GooroomNotifyWindow *window,
 
 	g_signal_emit (G_OBJECT(window), signals[SIG_CLOSED], 0, reason);
 }
+
+void
+gooroom_notify_window_invoke_action (GooroomNotifyWindow *window,
+                                     const gchar         *action_id)
+{
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window) && action_id);
+
+	g_signal_emit (G_OBJECT (window), signals[SIG_ACTION_INVOKED], 0, action_id);
+	g_signal_emit (G_OBJECT (window), signals[SIG_CLOSED], 0,
+                   GOOROOM_NOTIFY_CLOSE_REASON_DISMISSED);
+}
+
+void
+gooroom_notify_window_set_hovered (GooroomNotifyWindow *window,
+                                   gboolean             hovered)
+{
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (!hovered) {
+		if (priv->expire_paused) {
+			/* carry on with the time that was left */
+			gooroom_notify_timer_resume (priv->expire_id);
+			priv->expire_paused = FALSE;
+		} else if (!priv->expire_id && !priv->fade_id) {
+			gooroom_notify_window_start_expiration (window);
+		}
+		return;
+	}
+
+	if (priv->expire_timeout) {
+		if (priv->expire_id && !priv->expire_paused) {
+			gooroom_notify_timer_pause (priv->expire_id);
+			priv->expire_paused = TRUE;
+		}
+		if (priv->fade_id) {
+			gooroom_notify_animation_cancel (priv->fade_id);
+			priv->fade_id = 0;
+			/* reset the sliding-out window to its original position */
+			gooroom_notify_window_reset_slide (window);
+		}
+	}
+}
+
+void
+gooroom_notify_window_set_overlay (GooroomNotifyWindow *window,
+                                   GtkWidget           *overlay)
+{
+	gboolean attach;
+
+	g_return_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window));
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	attach = (priv->overlay == NULL && overlay != NULL);
+
+	if (!overlay)
+		gooroom_notify_window_stop_expiration (window);
+
+	/* a fade runs on the frame clock of the old overlay, which is about
+	 * to go away */
+	if (priv->overlay && overlay && priv->overlay != overlay && priv->fade_id) {
+		gooroom_notify_window_stop_expiration (window);
+		gooroom_notify_window_reset_slide (window);
+		attach = TRUE;
+	}
+
+	priv->overlay = overlay;
+
+	/* being attached to an overlay stands in for realize, which never
+	 * happens to a window that is drawn by an overlay */
+	if (attach && !gtk_widget_get_realized (GTK_WIDGET (window)))
+		gooroom_notify_window_start_expiration (window);
+}
+
+GtkWidget *
+gooroom_notify_window_get_overlay (GooroomNotifyWindow *window)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), NULL);
+
+	return window->priv->overlay;
+}
+
+gdouble
+gooroom_notify_window_get_paint_opacity (GooroomNotifyWindow *window)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), 0.0);
+
+	return window->priv->paint_opacity;
+}
+
+gint
+gooroom_notify_window_get_slide_offset (GooroomNotifyWindow *window)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), 0);
+
+	return window->priv->slide_offset;
+}
+
+gboolean
+gooroom_notify_window_get_icon_only (GooroomNotifyWindow *window)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), FALSE);
+
+	return window->priv->icon_only;
+}
+
+gint
+gooroom_notify_window_get_gauge_value (GooroomNotifyWindow *window)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), -1);
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (!priv->gauge)
+		return -1;
+
+	return (gint)(gtk_progress_bar_get_fraction (GTK_PROGRESS_BAR (priv->gauge)) * 100.0 + 0.5);
+}
+
+static PangoLayout *
+gooroom_notify_window_ref_label_layout (GtkWidget *label,
+                                        gint       width,
+                                        gint       lines)
+{
+	PangoLayout *layout;
+	gchar *markup = NULL;
+	const gchar *text = gtk_label_get_label (GTK_LABEL (label));
+	gboolean use_markup = gtk_label_get_use_markup (GTK_LABEL (label));
+
+	/* pango does not know the links GtkLabel handles */
+	if (use_markup && strstr (text, "<a "))
+		text = markup = notify_markup_sanitize (text, 0, FALSE);
+
+	/* the label's pango context carries the font the theme assigns to it */
+	layout = gooroom_notify_layout_cache_lookup (gtk_widget_get_pango_context (label),
+	                                             text, use_markup, width, lines);
+	g_free (markup);
+
+	return layout;
+}
+
+/* The layouts are shared through the layout cache and must not be
+ * modified. */
+PangoLayout *
+gooroom_notify_window_ref_summary_layout (GooroomNotifyWindow *window,
+                                          gint                 width,
+                                          gint                 lines)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), NULL);
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (!priv->has_summary_text)
+		return NULL;
+
+	return gooroom_notify_window_ref_label_layout (priv->summary, width, lines);
+}
+
+PangoLayout *
+gooroom_notify_window_ref_body_layout (GooroomNotifyWindow *window,
+                                       gint                 width,
+                                       gint                 lines)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), NULL);
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (!priv->has_body_text)
+		return NULL;
+
+	return gooroom_notify_window_ref_label_layout (priv->body, width, lines);
+}
+
+/* The never mapped widgets of an overlaid notification; the overlay takes
+ * their styles and spacings so that it follows the theme. The gauge is NULL
+ * without a value. */
+GtkWidget *
+gooroom_notify_window_get_part (GooroomNotifyWindow     *window,
+                                GooroomNotifyWindowPart  part)
+{
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), NULL);
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	switch (part) {
+		case GOOROOM_NOTIFY_WINDOW_PART_BOX:
+			return priv->main_box;
+		case GOOROOM_NOTIFY_WINDOW_PART_HEADER:
+			return gtk_widget_get_parent (priv->icon_box);
+		case GOOROOM_NOTIFY_WINDOW_PART_SUMMARY:
+			return priv->summary;
+		case GOOROOM_NOTIFY_WINDOW_PART_BODY:
+			return priv->body;
+		case GOOROOM_NOTIFY_WINDOW_PART_GAUGE:
+			return priv->gauge;
+		case GOOROOM_NOTIFY_WINDOW_PART_BUTTON_BOX:
+			return priv->button_box;
+		default:
+			g_return_val_if_reached (NULL);
+	}
+}
+
+cairo_surface_t *
+gooroom_notify_window_create_icon_surface (GooroomNotifyWindow *window,
+                                           gint                 size,
+                                           gint                 scale)
+{
+	GtkIconTheme *theme;
+	GtkIconInfo *info;
+	GIcon *gicon = NULL;
+	const gchar *icon_name = NULL;
+	cairo_surface_t *surface = NULL;
+
+	g_return_val_if_fail (GOOROOM_IS_NOTIFY_WINDOW (window), NULL);
+
+	GooroomNotifyWindowPrivate *priv = window->priv;
+
+	if (!gtk_widget_get_visible (priv->icon_box))
+		return NULL;
+
+	theme = gtk_icon_theme_get_default ();
+
+	switch (gtk_image_get_storage_type (GTK_IMAGE (priv->icon))) {
+		case GTK_IMAGE_PIXBUF:
+			surface = gdk_cairo_surface_create_from_pixbuf (gtk_image_get_pixbuf (GTK_IMAGE (priv->icon)),
+			                                                scale, NULL);
+			break;
+		case GTK_IMAGE_SURFACE:
+			g_object_get (priv->icon, "surface", &surface, NULL);
+			break;
+		case GTK_IMAGE_GICON:
+			gtk_image_get_gicon (GTK_IMAGE (priv->icon), &gicon, NULL);
+			info = gtk_icon_theme_lookup_by_gicon_for_scale (theme, gicon, size, scale,
+			                                                 GTK_ICON_LOOKUP_FORCE_SIZE);
+			if (info) {
+				surface = gtk_icon_info_load_surface (info, NULL, NULL);
+				g_object_unref (info);
+			}
+			break;
+		case GTK_IMAGE_ICON_NAME:
+			gtk_image_get_icon_name (GTK_IMAGE (priv->icon), &icon_name, NULL);
+			surface = gtk_icon_theme_load_surface (theme, icon_name, size, scale, NULL,
+			                                       GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+			break;
+		default:
+			break;
+	}
+
+	return surface;
+}
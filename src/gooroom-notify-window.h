@@ -95,9 +95,16 @@ void gooroom_notify_window_set_icon_name (GooroomNotifyWindow *window,
                                           const gchar *icon_name);
 void gooroom_notify_window_set_icon_pixbuf (GooroomNotifyWindow *window,
                                             GdkPixbuf *pixbuf);
+void gooroom_notify_window_set_icon_surface (GooroomNotifyWindow *window,
+                                             cairo_surface_t *surface);
+void gooroom_notify_window_set_icon_data (GooroomNotifyWindow *window,
+                                          GVariant *image_data);
+void gooroom_notify_window_set_icon_scale (GooroomNotifyWindow *window,
+                                           gint scale);
 
 void gooroom_notify_window_set_expire_timeout (GooroomNotifyWindow *window,
                                                gint expire_timeout);
+gint gooroom_notify_window_get_remaining_timeout (GooroomNotifyWindow *window);
 
 void gooroom_notify_window_set_actions (GooroomNotifyWindow *window,
                                         const gchar **actions);
@@ -126,6 +133,44 @@ void gooroom_notify_window_set_notify_location (GooroomNotifyWindow *window,
 /* signal trigger */
 void gooroom_notify_window_closed (GooroomNotifyWindow *window,
                                    GooroomNotifyCloseReason reason);
+void gooroom_notify_window_invoke_action (GooroomNotifyWindow *window,
+                                          const gchar *action_id);
+
+/* pointer tracking for windows that do not get crossing events themselves */
+void gooroom_notify_window_set_hovered (GooroomNotifyWindow *window,
+                                        gboolean hovered);
+
+/* overlay rendering */
+typedef enum
+{
+    GOOROOM_NOTIFY_WINDOW_PART_BOX,
+    GOOROOM_NOTIFY_WINDOW_PART_HEADER,
+    GOOROOM_NOTIFY_WINDOW_PART_SUMMARY,
+    GOOROOM_NOTIFY_WINDOW_PART_BODY,
+    GOOROOM_NOTIFY_WINDOW_PART_GAUGE,
+    GOOROOM_NOTIFY_WINDOW_PART_BUTTON_BOX,
+} GooroomNotifyWindowPart;
+
+void gooroom_notify_window_set_overlay (GooroomNotifyWindow *window,
+                                        GtkWidget *overlay);
+GtkWidget *gooroom_notify_window_get_overlay (GooroomNotifyWindow *window);
+
+gdouble gooroom_notify_window_get_paint_opacity (GooroomNotifyWindow *window);
+gint gooroom_notify_window_get_slide_offset (GooroomNotifyWindow *window);
+gboolean gooroom_notify_window_get_icon_only (GooroomNotifyWindow *window);
+gint gooroom_notify_window_get_gauge_value (GooroomNotifyWindow *window);
+
+PangoLayout *gooroom_notify_window_ref_summary_layout (GooroomNotifyWindow *window,
+                                                      gint width,
+                                                      gint lines);
+PangoLayout *gooroom_notify_window_ref_body_layout (GooroomNotifyWindow *window,
+                                                   gint width,
+                                                   gint lines);
+cairo_surface_t *gooroom_notify_window_create_icon_surface (GooroomNotifyWindow *window,
+                                                            gint size,
+                                                            gint scale);
+GtkWidget *gooroom_notify_window_get_part (GooroomNotifyWindow *window,
+                                           GooroomNotifyWindowPart part);
 
 G_END_DECLS
 
@@ -31,18 +31,52 @@
 #include <gtk/gtk.h>
 
 #include "gooroom-notify-daemon.h"
+#include "gooroom-notify-icon-atlas.h"
+
+static gboolean opt_build_icon_atlas = FALSE;
+static gchar *opt_icon_theme = NULL;
+
+static GOptionEntry option_entries[] =
+{
+    { "build-icon-atlas", 0, 0, G_OPTION_ARG_NONE, &opt_build_icon_atlas,
+      "Build the icon atlas shared by all sessions on this host, then exit", NULL },
+    { "icon-theme", 0, 0, G_OPTION_ARG_STRING, &opt_icon_theme,
+      "Icon theme to build the atlas for", "NAME" },
+    { NULL }
+};
 
 int
 main (int argc, char **argv)
 {
     GError *error = NULL;
+    gboolean has_display;
     GooroomNotifyDaemon *xndaemon;
 
 	setlocale (LC_ALL, "");
 	bindtextdomain (GETTEXT_PACKAGE, GNOMELOCALEDIR);
 	textdomain (GETTEXT_PACKAGE);
 
-    gtk_init (&argc, &argv);
+    has_display = gtk_init_with_args (&argc, &argv, NULL, option_entries, GETTEXT_PACKAGE, &error);
+    if (error) {
+        fprintf (stderr, "%s\n", error->message);
+        g_error_free (error);
+        return 1;
+    }
+
+    /* the atlas can be built without a display, e.g. on package install */
+    if (opt_build_icon_atlas) {
+        if (!gooroom_notify_icon_atlas_build (ICON_ATLAS_FILE, opt_icon_theme, &error)) {
+            fprintf (stderr, "Unable to build the icon atlas: %s\n", error->message);
+            g_error_free (error);
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!has_display) {
+        fprintf (stderr, "Unable to start notification daemon: cannot open display\n");
+        return 1;
+    }
 
     xndaemon = gooroom_notify_daemon_new_unique (&error);
     if(!xndaemon) {
@@ -0,0 +1,29 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* The icon scaler once more, without its SSE2 path and under other names,
+ * for test-icon-scale to compare the two. */
+
+#define GOOROOM_NOTIFY_ICON_SCALE_SCALAR
+
+#define gooroom_notify_icon_scale_fit     icon_scale_scalar_fit
+#define gooroom_notify_icon_scale_pixbuf  icon_scale_scalar_pixbuf
+#define gooroom_notify_icon_scale_render  icon_scale_scalar_render
+
+#include "gooroom-notify-icon-scale.c"
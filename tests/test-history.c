@@ -0,0 +1,474 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Appends closed notifications to a history in a scratch XDG_DATA_HOME
+ * and checks what GetHistory gets back: rotation, paging across the two
+ * generations, the time filters, a clock set back and applications that
+ * share a hash. The perf case times a million appends and the queries
+ * GetHistory serves under -m perf, a smaller log otherwise. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib/gstdio.h>
+
+#include "gooroom-notify-history.h"
+
+#define N_QUERIES     20
+#define PAGE_SIZE     50
+#define MAX_PAGE      500
+#define RARE_APP_STEP 1000
+
+/* every test starts its records well after those of the one before, the
+ * history keeps its index in order of time across the whole run */
+#define BASE_TIME     G_GINT64_CONSTANT (1600000000000000)
+#define TEST_SPAN     (G_GINT64_CONSTANT (10000000) * G_USEC_PER_SEC)
+#define RECORD_TIME(i) (base_time + (gint64)(i) * G_USEC_PER_SEC)
+
+static gchar *data_dir = NULL;
+static gint64 base_time = BASE_TIME;
+
+static void
+remove_dir (const gchar *path)
+{
+	GDir *dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+
+	while (dir && (name = g_dir_read_name (dir))) {
+		gchar *child = g_build_filename (path, name, NULL);
+
+		if (g_file_test (child, G_FILE_TEST_IS_DIR))
+			remove_dir (child);
+		else
+			g_unlink (child);
+		g_free (child);
+	}
+
+	if (dir)
+		g_dir_close (dir);
+	g_rmdir (path);
+}
+
+/* starts every test on an empty history */
+static void
+reset_history (gsize max_size)
+{
+	gchar *path;
+
+	gooroom_notify_history_close ();
+
+	path = g_build_filename (data_dir, "gooroom-notifyd", NULL);
+	remove_dir (path);
+	g_free (path);
+
+	base_time += TEST_SPAN;
+	gooroom_notify_history_set_max_size (max_size);
+}
+
+static goffset
+file_size (const gchar *name)
+{
+	gchar *path;
+	GStatBuf st;
+	goffset size = 0;
+
+	path = g_build_filename (data_dir, "gooroom-notifyd", "history", name, NULL);
+	if (g_stat (path, &st) == 0)
+		size = st.st_size;
+	g_free (path);
+
+	return size;
+}
+
+static void
+query_done (GObject      *source_object,
+            GAsyncResult *result,
+            gpointer      user_data)
+{
+	GVariant **entries = user_data;
+	GError *error = NULL;
+
+	*entries = gooroom_notify_history_query_finish (result, &error);
+	g_assert_no_error (error);
+}
+
+static GVariant *
+query_page (guint        offset,
+            guint        limit,
+            const gchar *app_name,
+            gint64       since,
+            gint64       until)
+{
+	GVariant *entries = NULL;
+
+	gooroom_notify_history_query_async (offset, limit, app_name, since, until,
+	                                    query_done, &entries);
+	while (!entries)
+		g_main_context_iteration (NULL, TRUE);
+
+	return entries;
+}
+
+static GVariant *
+query (guint        offset,
+       const gchar *app_name,
+       gint64       since,
+       gint64       until)
+{
+	return query_page (offset, PAGE_SIZE, app_name, since, until);
+}
+
+/* pages through everything a query matches and returns the ids, newest
+ * first, after checking the entries against the filters */
+static GArray *
+query_ids (const gchar *app_name,
+           gint64       since,
+           gint64       until)
+{
+	GArray *ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	for (;;) {
+		GVariant *entries = query_page (ids->len, MAX_PAGE, app_name, since, until);
+		gsize i, n = g_variant_n_children (entries);
+
+		for (i = 0; i < n; i++) {
+			const gchar *app;
+			guint32 id;
+
+			g_variant_get_child (entries, i, "(ux&s&s&su)", &id, NULL, &app, NULL, NULL, NULL);
+			if (app_name)
+				g_assert_cmpstr (app, ==, app_name);
+			g_array_append_val (ids, id);
+		}
+		g_variant_unref (entries);
+
+		if (n < MAX_PAGE)
+			return ids;
+	}
+}
+
+/* the ids have to run down one by one from newest */
+static void
+assert_ids_from (GArray  *ids,
+                 guint32  newest)
+{
+	guint i;
+
+	for (i = 0; i < ids->len; i++)
+		g_assert_cmpuint (g_array_index (ids, guint32, i), ==, newest - i);
+}
+
+/* checks the first entry of a result and returns the number of entries */
+static gsize
+check_first (GVariant    *entries,
+             guint32      id,
+             const gchar *app_name)
+{
+	guint32 first_id;
+	gint64 timestamp;
+	const gchar *first_app;
+
+	if (g_variant_n_children (entries) == 0)
+		return 0;
+
+	g_variant_get_child (entries, 0, "(ux&s&s&su)", &first_id, &timestamp, &first_app,
+	                     NULL, NULL, NULL);
+	g_assert_cmpuint (first_id, ==, id);
+	g_assert_cmpint (timestamp, ==, RECORD_TIME (id));
+	g_assert_cmpstr (first_app, ==, app_name);
+
+	return g_variant_n_children (entries);
+}
+
+static const gchar *
+record_app (guint32 id)
+{
+	return id % RARE_APP_STEP == 0 ? "rare-app" : id % 2 ? "mail-client" : "messenger";
+}
+
+static void
+append (guint32      id,
+        gint64       timestamp,
+        const gchar *app_name)
+{
+	gooroom_notify_history_append (id, timestamp, app_name,
+	                               "Re: Quarterly report",
+	                               "Please find the updated figures attached, "
+	                               "the numbers for March are still missing.",
+	                               2);
+}
+
+static void
+test_history_rotation (void)
+{
+	const gsize max_size = 256 * 1024;
+	goffset log_size, old_log_size;
+	guint32 id;
+
+	reset_history (max_size);
+
+	/* enough for several rotations */
+	for (id = 1; id <= 10000; id++)
+		append (id, RECORD_TIME (id), record_app (id));
+	gooroom_notify_history_close ();
+
+	/* the log moves away once it is past half the budget, after the batch
+	 * that took it there */
+	log_size = file_size ("log");
+	old_log_size = file_size ("log.1");
+	g_assert_cmpint (log_size, <=, max_size / 2);
+	g_assert_cmpint (old_log_size, >, max_size / 2);
+	g_assert_cmpint (log_size + old_log_size, <, max_size + max_size / 8);
+
+	g_assert_cmpint (file_size ("index") % 24, ==, 0);
+	g_assert_cmpint (file_size ("index.1") % 24, ==, 0);
+	g_assert_cmpint (file_size ("log.2"), ==, 0);
+}
+
+static void
+test_history_generations (void)
+{
+	GVariant *entries;
+	GArray *ids;
+	gsize n_current, n_old;
+	guint32 id, first, oldest;
+
+	reset_history (256 * 1024);
+
+	for (id = 1; id <= 3000; id++)
+		append (id, RECORD_TIME (id), record_app (id));
+	gooroom_notify_history_close ();
+
+	n_current = file_size ("index") / 24;
+	n_old = file_size ("index.1") / 24;
+	g_assert_cmpuint (n_old, >, 0);
+
+	/* paging runs from the newest generation straight into the one before */
+	ids = query_ids (NULL, 0, 0);
+	g_assert_cmpuint (ids->len, ==, n_current + n_old);
+	assert_ids_from (ids, 3000);
+	oldest = g_array_index (ids, guint32, ids->len - 1);
+	g_array_unref (ids);
+
+	/* and so does a page that starts in one and ends in the other */
+	g_assert_cmpuint (n_current, >, PAGE_SIZE / 2);
+	first = 3000 - (n_current - PAGE_SIZE / 2);
+	entries = query (n_current - PAGE_SIZE / 2, NULL, 0, 0);
+	g_assert_cmpuint (check_first (entries, first, record_app (first)), ==, PAGE_SIZE);
+	g_variant_unref (entries);
+
+	/* a filtered query finds the oldest entries too */
+	ids = query_ids (record_app (oldest), 0, RECORD_TIME (oldest));
+	g_assert_cmpuint (ids->len, ==, 1);
+	g_assert_cmpuint (g_array_index (ids, guint32, 0), ==, oldest);
+	g_array_unref (ids);
+}
+
+static void
+test_history_since (void)
+{
+	GArray *ids;
+	guint32 id;
+
+	reset_history (256 * 1024);
+
+	for (id = 1; id <= 3000; id++)
+		append (id, RECORD_TIME (id), record_app (id));
+	gooroom_notify_history_close ();
+
+	/* within the newest generation */
+	ids = query_ids (NULL, RECORD_TIME (2990), 0);
+	g_assert_cmpuint (ids->len, ==, 11);
+	assert_ids_from (ids, 3000);
+	g_array_unref (ids);
+
+	/* reaching back into the previous one */
+	ids = query_ids (NULL, RECORD_TIME (3000 - file_size ("index") / 24 - 10), 0);
+	g_assert_cmpuint (ids->len, ==, file_size ("index") / 24 + 11);
+	assert_ids_from (ids, 3000);
+	g_array_unref (ids);
+
+	/* after the newest */
+	ids = query_ids (NULL, RECORD_TIME (3001), 0);
+	g_assert_cmpuint (ids->len, ==, 0);
+	g_array_unref (ids);
+}
+
+static void
+test_history_clock_set_back (void)
+{
+	GVariant *entries;
+	GArray *ids;
+	gint64 timestamp;
+
+	reset_history (GOOROOM_NOTIFY_HISTORY_DEFAULT_SIZE);
+
+	append (1, RECORD_TIME (100), "messenger");
+	append (2, RECORD_TIME (10), "messenger");
+	append (3, RECORD_TIME (101), "messenger");
+	gooroom_notify_history_close ();
+
+	/* the order of the appends wins, the entry keeps its own time */
+	ids = query_ids (NULL, 0, 0);
+	g_assert_cmpuint (ids->len, ==, 3);
+	assert_ids_from (ids, 3);
+	g_array_unref (ids);
+
+	entries = query (1, NULL, 0, 0);
+	g_variant_get_child (entries, 0, "(ux&s&s&su)", NULL, &timestamp, NULL, NULL, NULL, NULL);
+	g_assert_cmpint (timestamp, ==, RECORD_TIME (10));
+	g_variant_unref (entries);
+
+	/* the filters see it at the time of the entry before it */
+	ids = query_ids (NULL, 0, RECORD_TIME (100));
+	g_assert_cmpuint (ids->len, ==, 2);
+	assert_ids_from (ids, 2);
+	g_array_unref (ids);
+
+	ids = query_ids (NULL, 0, RECORD_TIME (50));
+	g_assert_cmpuint (ids->len, ==, 0);
+	g_array_unref (ids);
+
+	ids = query_ids (NULL, RECORD_TIME (100), 0);
+	g_assert_cmpuint (ids->len, ==, 3);
+	g_array_unref (ids);
+
+	ids = query_ids (NULL, RECORD_TIME (101), 0);
+	g_assert_cmpuint (ids->len, ==, 1);
+	g_array_unref (ids);
+}
+
+static void
+test_history_app_hash_collision (void)
+{
+	/* 'A' * 33 + 'a' == 'B' * 33 + '@' */
+	const gchar *app = "app-Aa", *other = "app-B@";
+	GArray *ids;
+	guint32 id;
+
+	g_assert_cmpuint (g_str_hash (app), ==, g_str_hash (other));
+
+	reset_history (GOOROOM_NOTIFY_HISTORY_DEFAULT_SIZE);
+
+	for (id = 1; id <= 200; id++)
+		append (id, RECORD_TIME (id), id % 4 ? other : app);
+	gooroom_notify_history_close ();
+
+	ids = query_ids (app, 0, 0);
+	g_assert_cmpuint (ids->len, ==, 50);
+	g_assert_cmpuint (g_array_index (ids, guint32, 0), ==, 200);
+	g_array_unref (ids);
+
+	ids = query_ids (other, 0, 0);
+	g_assert_cmpuint (ids->len, ==, 150);
+	g_assert_cmpuint (g_array_index (ids, guint32, 0), ==, 199);
+	g_array_unref (ids);
+}
+
+static void
+report_query (const gchar *name,
+              gdouble      elapsed)
+{
+	g_test_message ("%s: %.3f ms per query", name, elapsed * 1e3 / N_QUERIES);
+	g_test_minimized_result (elapsed * 1e3 / N_QUERIES, "%s: %.3f ms", name, elapsed * 1e3 / N_QUERIES);
+}
+
+static void
+test_history_perf (void)
+{
+	GVariant *entries;
+	gdouble elapsed;
+	guint32 id, n_records = g_test_perf () ? 1000000 : 10000;
+	guint32 mid = n_records / 2;
+	gint i;
+
+	reset_history (G_MAXSIZE);
+
+	g_test_timer_start ();
+	for (id = 1; id <= n_records; id++)
+		append (id, RECORD_TIME (id), record_app (id));
+	gooroom_notify_history_close ();
+	elapsed = g_test_timer_elapsed ();
+
+	g_test_message ("appended %u records in %.3f s, %.0f records/s",
+	                n_records, elapsed, n_records / elapsed);
+	g_test_maximized_result (n_records / elapsed, "%.0f records/s", n_records / elapsed);
+
+	g_test_timer_start ();
+	for (i = 0; i < N_QUERIES; i++) {
+		entries = query (0, NULL, 0, 0);
+		g_assert_cmpuint (check_first (entries, n_records, record_app (n_records)), ==, PAGE_SIZE);
+		g_variant_unref (entries);
+	}
+	report_query ("newest page", g_test_timer_elapsed ());
+
+	/* paging walks the skipped entries, this is the slow case */
+	g_test_timer_start ();
+	for (i = 0; i < N_QUERIES; i++) {
+		entries = query (mid, NULL, 0, 0);
+		g_assert_cmpuint (check_first (entries, n_records - mid, record_app (n_records - mid)), ==, PAGE_SIZE);
+		g_variant_unref (entries);
+	}
+	report_query ("page at half the log", g_test_timer_elapsed ());
+
+	g_test_timer_start ();
+	for (i = 0; i < N_QUERIES; i++) {
+		entries = query (0, "rare-app", 0, 0);
+		g_assert_cmpuint (check_first (entries, n_records / RARE_APP_STEP * RARE_APP_STEP, "rare-app"), ==,
+		                  MIN (PAGE_SIZE, n_records / RARE_APP_STEP));
+		g_variant_unref (entries);
+	}
+	report_query ("one application in a thousand", g_test_timer_elapsed ());
+
+	g_test_timer_start ();
+	for (i = 0; i < N_QUERIES; i++) {
+		entries = query (0, NULL, RECORD_TIME (mid - 10), RECORD_TIME (mid));
+		g_assert_cmpuint (check_first (entries, mid, record_app (mid)), ==, 11);
+		g_variant_unref (entries);
+	}
+	report_query ("time range", g_test_timer_elapsed ());
+}
+
+int
+main (int argc, char **argv)
+{
+	gint ret;
+
+	/* before anything asks glib for the data dir */
+	data_dir = g_dir_make_tmp ("test-history-XXXXXX", NULL);
+	g_assert_nonnull (data_dir);
+	g_setenv ("XDG_DATA_HOME", data_dir, TRUE);
+
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/history/rotation", test_history_rotation);
+	g_test_add_func ("/history/generations", test_history_generations);
+	g_test_add_func ("/history/since", test_history_since);
+	g_test_add_func ("/history/clock-set-back", test_history_clock_set_back);
+	g_test_add_func ("/history/app-hash-collision", test_history_app_hash_collision);
+	g_test_add_func ("/history/perf/append-and-query", test_history_perf);
+
+	ret = g_test_run ();
+
+	remove_dir (data_dir);
+	g_free (data_dir);
+
+	return ret;
+}
@@ -0,0 +1,272 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Measures what the icon atlas saves on a terminal server: forked
+ * processes, 50 under -m perf and 10 otherwise, stand in for the daemons
+ * of as many sessions, hold the same system icons either decoded on their
+ * own heap or looked up in the atlas, and their summed PSS is compared.
+ * An idle run of the same processes is subtracted from both. Needs a
+ * display for the icon theme setting, and is skipped without one. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gtk/gtk.h>
+
+#include "gooroom-notify-icon-atlas.h"
+
+typedef enum
+{
+	SESSION_IDLE,
+	SESSION_PRIVATE,
+	SESSION_ATLAS,
+} SessionMode;
+
+static gchar  *atlas_file = NULL;
+static GList  *icon_names = NULL;
+static gint    icon_size;
+static gint    ready_fd = -1;
+static gint    hold_fd = -1;
+
+/* kB of proportional set size, from smaps_rollup where the kernel has it */
+static guint64
+read_pss (pid_t pid)
+{
+	const gchar *files[] = { "smaps_rollup", "smaps" };
+	guint64 pss = 0;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (files); i++) {
+		gchar *path, *contents, **lines, **l;
+
+		path = g_strdup_printf ("/proc/%d/%s", (gint)pid, files[i]);
+		if (!g_file_get_contents (path, &contents, NULL, NULL)) {
+			g_free (path);
+			continue;
+		}
+		g_free (path);
+
+		lines = g_strsplit (contents, "\n", -1);
+		for (l = lines; *l; l++) {
+			if (g_str_has_prefix (*l, "Pss:"))
+				pss += g_ascii_strtoull (*l + 4, NULL, 10);
+		}
+		g_strfreev (lines);
+		g_free (contents);
+
+		return pss;
+	}
+
+	return 0;
+}
+
+/* the session's icons are painted once, which is what pulls them in */
+static void
+session_run (SessionMode mode)
+{
+	GtkIconTheme *theme = NULL;
+	GPtrArray *held;
+	cairo_surface_t *target;
+	cairo_t *cr;
+	GList *l;
+	gchar c;
+
+	held = g_ptr_array_new_with_free_func ((GDestroyNotify)cairo_surface_destroy);
+	target = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, icon_size, icon_size);
+	cr = cairo_create (target);
+
+	if (mode == SESSION_ATLAS) {
+		gooroom_notify_icon_atlas_open (atlas_file);
+	} else if (mode == SESSION_PRIVATE) {
+		gchar *theme_name = NULL;
+
+		g_object_get (gtk_settings_get_default (), "gtk-icon-theme-name", &theme_name, NULL);
+		theme = gtk_icon_theme_new ();
+		gtk_icon_theme_set_custom_theme (theme, theme_name);
+		g_free (theme_name);
+	}
+
+	for (l = icon_names; mode != SESSION_IDLE && l; l = l->next) {
+		cairo_surface_t *icon;
+
+		if (mode == SESSION_ATLAS)
+			icon = gooroom_notify_icon_atlas_lookup (l->data, icon_size, 1);
+		else
+			icon = gtk_icon_theme_load_surface (theme, l->data, icon_size, 1, NULL,
+			                                    GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+		if (!icon)
+			continue;
+
+		cairo_set_source_surface (cr, icon, 0, 0);
+		cairo_paint (cr);
+		g_ptr_array_add (held, icon);
+	}
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (target);
+
+	/* keep everything until the parent has measured, or is gone */
+	if (write (ready_fd, "", 1) != 1)
+		_exit (1);
+	while (read (hold_fd, &c, 1) < 0 && errno == EINTR)
+		;
+
+	_exit (0);
+}
+
+/* the children hold on until the parent closes its end of the hold pipe,
+ * which also happens when it dies */
+static guint64
+measure_sessions (SessionMode mode,
+                  gint        n_sessions)
+{
+	pid_t *pids = g_new (pid_t, n_sessions);
+	gint ready[2], hold[2];
+	guint64 total = 0;
+	gchar c;
+	gint i;
+
+	g_assert_cmpint (pipe (ready), ==, 0);
+	g_assert_cmpint (pipe (hold), ==, 0);
+	ready_fd = ready[1];
+	hold_fd = hold[0];
+
+	for (i = 0; i < n_sessions; i++) {
+		pids[i] = fork ();
+		g_assert_cmpint (pids[i], >=, 0);
+		if (pids[i] == 0) {
+			close (ready[0]);
+			close (hold[1]);
+			session_run (mode);
+		}
+	}
+
+	close (ready[1]);
+	close (hold[0]);
+
+	for (i = 0; i < n_sessions; i++)
+		g_assert_cmpint (read (ready[0], &c, 1), ==, 1);
+
+	for (i = 0; i < n_sessions; i++)
+		total += read_pss (pids[i]);
+
+	close (hold[1]);
+	for (i = 0; i < n_sessions; i++)
+		waitpid (pids[i], NULL, 0);
+
+	close (ready[0]);
+	g_free (pids);
+
+	return total;
+}
+
+static void
+test_icon_atlas_pss (void)
+{
+	guint64 idle, before, after;
+	gint n_sessions = g_test_perf () ? 50 : 10;
+
+	if (!atlas_file) {
+		g_test_skip ("no display or no icons in the theme");
+		return;
+	}
+
+	idle = measure_sessions (SESSION_IDLE, n_sessions);
+	before = measure_sessions (SESSION_PRIVATE, n_sessions) - idle;
+	after = measure_sessions (SESSION_ATLAS, n_sessions) - idle;
+
+	g_test_message ("%u icons in %d sessions: %" G_GUINT64_FORMAT " kB PSS decoded per "
+	                "session, %" G_GUINT64_FORMAT " kB PSS from the atlas",
+	                g_list_length (icon_names), n_sessions, before, after);
+	g_test_minimized_result (after, "%" G_GUINT64_FORMAT " kB", after);
+
+	g_assert_cmpuint (after, <, before);
+}
+
+static void
+setup_atlas (void)
+{
+	GtkIconTheme *theme;
+	gchar *theme_name = NULL, *dir;
+	GError *error = NULL;
+	const gchar *contexts[] = { "Applications", "Status", "Devices" };
+	gint w, h;
+	guint i;
+
+	g_object_get (gtk_settings_get_default (), "gtk-icon-theme-name", &theme_name, NULL);
+	if (!theme_name)
+		return;
+
+	gtk_icon_size_lookup (GTK_ICON_SIZE_DND, &w, &h);
+	icon_size = MIN (w, h);
+
+	/* the names the atlas is built from */
+	theme = gtk_icon_theme_new ();
+	gtk_icon_theme_set_custom_theme (theme, theme_name);
+	for (i = 0; i < G_N_ELEMENTS (contexts); i++)
+		icon_names = g_list_concat (icon_names, gtk_icon_theme_list_icons (theme, contexts[i]));
+	g_object_unref (theme);
+	g_free (theme_name);
+
+	if (!icon_names)
+		return;
+
+	dir = g_dir_make_tmp ("test-icon-atlas-XXXXXX", &error);
+	g_assert_no_error (error);
+	atlas_file = g_build_filename (dir, "icon-atlas", NULL);
+	g_free (dir);
+
+	gooroom_notify_icon_atlas_build (atlas_file, NULL, &error);
+	g_assert_no_error (error);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint ret;
+
+	g_test_init (&argc, &argv, NULL);
+
+	if (gtk_init_check (&argc, &argv))
+		setup_atlas ();
+
+	g_test_add_func ("/icon-atlas/perf/pss", test_icon_atlas_pss);
+
+	ret = g_test_run ();
+
+	if (atlas_file) {
+		gchar *dir = g_path_get_dirname (atlas_file);
+
+		g_unlink (atlas_file);
+		g_rmdir (dir);
+		g_free (dir);
+	}
+	g_free (atlas_file);
+	g_list_free_full (icon_names, g_free);
+
+	return ret;
+}
@@ -0,0 +1,253 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Decodes 4K and 8K JPEGs down to a notification icon, once through the
+ * daemon's loader, which asks for the icon size from size-prepared, and
+ * once through gdk_pixbuf_new_from_file_at_size (). Reports the time per
+ * decode and the peak RSS of each path, taken in a forked child that
+ * decodes the image once, less that of a child that decodes nothing.
+ * Decodes 2 times per path, 20 under -m perf. Skipped without a JPEG
+ * saver. */
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+/* for the decoder the icon cache workers use */
+#include "gooroom-notify-icon-cache.c"
+
+#define ICON_SIZE 48
+
+typedef GdkPixbuf *(*DecodeFunc) (const gchar *path);
+
+typedef struct
+{
+	const gchar *name;
+	gint         width;
+	gint         height;
+} TestImage;
+
+static const TestImage images[] = {
+	{ "4k", 3840, 2160 },
+	{ "8k", 7680, 4320 },
+};
+
+static gchar *image_dir = NULL;
+
+static GdkPixbuf *
+decode_loader (const gchar *path)
+{
+	GooroomNotifyIconJob job = { NULL, };
+	GFile *file;
+	GdkPixbuf *pixbuf;
+	GError *error = NULL;
+
+	job.location = (gchar *)path;
+	job.size = ICON_SIZE;
+	job.scale = 1;
+
+	file = g_file_new_for_path (path);
+	pixbuf = gooroom_notify_icon_cache_decode (&job, file, NULL, &error);
+	g_assert_no_error (error);
+	g_object_unref (file);
+
+	return pixbuf;
+}
+
+static GdkPixbuf *
+decode_at_size (const gchar *path)
+{
+	GdkPixbuf *pixbuf;
+	GError *error = NULL;
+
+	pixbuf = gdk_pixbuf_new_from_file_at_size (path, ICON_SIZE, ICON_SIZE, &error);
+	g_assert_no_error (error);
+
+	return pixbuf;
+}
+
+/* in a child, so the test process never holds the full image */
+static gboolean
+write_jpeg (const gchar *path,
+            gint         width,
+            gint         height)
+{
+	pid_t pid;
+	gint status;
+
+	pid = fork ();
+	g_assert_cmpint (pid, >=, 0);
+
+	if (pid == 0) {
+		GdkPixbuf *pixbuf;
+		guchar *pixels;
+		gint rowstride, x, y;
+
+		pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+		pixels = gdk_pixbuf_get_pixels (pixbuf);
+		rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+		/* gradients and stripes, something like a photo to the encoder */
+		for (y = 0; y < height; y++) {
+			guchar *p = pixels + (gsize)y * rowstride;
+
+			for (x = 0; x < width; x++, p += 3) {
+				p[0] = x * 255 / width;
+				p[1] = y * 255 / height;
+				p[2] = ((x / 37 + y / 23) & 1) ? 200 : 40;
+			}
+		}
+
+		_exit (gdk_pixbuf_save (pixbuf, path, "jpeg", NULL, "quality", "90", NULL) ? 0 : 1);
+	}
+
+	g_assert_cmpint (waitpid (pid, &status, 0), ==, pid);
+
+	return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+/* kB of the peak RSS of a child that decodes the image once */
+static glong
+peak_rss (DecodeFunc   decode,
+          const gchar *path)
+{
+	gint fds[2];
+	glong maxrss = 0;
+	pid_t pid;
+
+	g_assert_cmpint (pipe (fds), ==, 0);
+
+	pid = fork ();
+	g_assert_cmpint (pid, >=, 0);
+
+	if (pid == 0) {
+		struct rusage usage;
+
+		close (fds[0]);
+		if (decode)
+			g_object_unref (decode (path));
+
+		if (getrusage (RUSAGE_SELF, &usage) != 0 ||
+		    write (fds[1], &usage.ru_maxrss, sizeof (usage.ru_maxrss)) != sizeof (usage.ru_maxrss))
+			_exit (1);
+		_exit (0);
+	}
+
+	close (fds[1]);
+	g_assert_cmpint (read (fds[0], &maxrss, sizeof (maxrss)), ==, sizeof (maxrss));
+	close (fds[0]);
+	waitpid (pid, NULL, 0);
+
+	return maxrss;
+}
+
+static gdouble
+time_decode (DecodeFunc   decode,
+             const gchar *path,
+             gint         rounds)
+{
+	gint i;
+
+	g_test_timer_start ();
+	for (i = 0; i < rounds; i++)
+		g_object_unref (decode (path));
+
+	return g_test_timer_elapsed () * 1e3 / rounds;
+}
+
+static void
+check_icon (DecodeFunc   decode,
+            const gchar *path)
+{
+	GdkPixbuf *pixbuf = decode (path);
+	gint width = gdk_pixbuf_get_width (pixbuf), height = gdk_pixbuf_get_height (pixbuf);
+
+	/* a pixel less from rounding */
+	g_assert_cmpint (MAX (width, height), <=, ICON_SIZE);
+	g_assert_cmpint (MAX (width, height), >=, ICON_SIZE - 1);
+
+	g_object_unref (pixbuf);
+}
+
+static void
+test_icon_loader_perf (gconstpointer data)
+{
+	const TestImage *image = data;
+	gchar *path;
+	gdouble loader_time, at_size_time;
+	glong idle, loader_rss, at_size_rss;
+	gint rounds = g_test_perf () ? 20 : 2;
+
+	path = g_strdup_printf ("%s/%s.jpg", image_dir, image->name);
+
+	if (!write_jpeg (path, image->width, image->height)) {
+		g_test_skip ("no JPEG saver");
+		g_free (path);
+		return;
+	}
+
+	check_icon (decode_loader, path);
+	check_icon (decode_at_size, path);
+
+	loader_time = time_decode (decode_loader, path, rounds);
+	at_size_time = time_decode (decode_at_size, path, rounds);
+
+	idle = peak_rss (NULL, path);
+	loader_rss = peak_rss (decode_loader, path) - idle;
+	at_size_rss = peak_rss (decode_at_size, path) - idle;
+
+	g_test_message ("%dx%d: loader %.1f ms, %ld kB peak RSS; "
+	                "gdk_pixbuf_new_from_file_at_size %.1f ms, %ld kB peak RSS",
+	                image->width, image->height, loader_time, loader_rss,
+	                at_size_time, at_size_rss);
+	g_test_minimized_result (loader_time, "loader: %.1f ms", loader_time);
+	g_test_minimized_result (loader_rss, "loader: %ld kB", loader_rss);
+
+	g_unlink (path);
+	g_free (path);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint ret;
+	guint i;
+
+	g_test_init (&argc, &argv, NULL);
+
+	image_dir = g_dir_make_tmp ("test-icon-loader-XXXXXX", NULL);
+	g_assert_nonnull (image_dir);
+
+	for (i = 0; i < G_N_ELEMENTS (images); i++) {
+		gchar *path = g_strdup_printf ("/icon-loader/perf/%s", images[i].name);
+
+		g_test_add_data_func (path, &images[i], test_icon_loader_perf);
+		g_free (path);
+	}
+
+	ret = g_test_run ();
+
+	g_rmdir (image_dir);
+	g_free (image_dir);
+
+	return ret;
+}
@@ -0,0 +1,216 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gooroom-notify-icon-scale.h"
+
+#define N_ROUNDS 500
+#define ICON_SIZE 48
+
+typedef struct
+{
+	const gchar *name;
+	gint         width;
+	gint         height;
+} PerfSize;
+
+static const PerfSize perf_sizes[] = {
+	{ "64x64", 64, 64 },
+	{ "256x256", 256, 256 },
+	{ "1920x1080", 1920, 1080 },
+	{ "3840x2160", 3840, 2160 },
+};
+
+cairo_surface_t *icon_scale_scalar_pixbuf (GdkPixbuf *pixbuf,
+                                           gint       width,
+                                           gint       height);
+
+static void
+free_pixels (guchar   *pixels,
+             gpointer  data)
+{
+	g_free (data);
+}
+
+/* random pixels, row padding and a start that is not 16 byte aligned */
+static GdkPixbuf *
+make_pixbuf (gboolean has_alpha,
+             gint     width,
+             gint     height)
+{
+	gint n_channels = has_alpha ? 4 : 3;
+	gint offset = g_test_rand_int_range (0, 16);
+	gint stride = width * n_channels + g_test_rand_int_range (0, 33);
+	gsize size = (gsize)stride * height + offset;
+	guchar *data = g_malloc (size);
+	GdkPixbuf *pixbuf;
+	gsize i;
+
+	for (i = 0; i < size; i++)
+		data[i] = g_test_rand_int_range (0, 256);
+
+	/* fully transparent and opaque pixels are the usual corner cases */
+	for (i = offset + 3; has_alpha && i < size; i += 4 * g_test_rand_int_range (1, 8))
+		data[i] = g_test_rand_bit () ? 0 : 255;
+
+	pixbuf = gdk_pixbuf_new_from_data (data + offset, GDK_COLORSPACE_RGB, has_alpha, 8,
+	                                   width, height, stride, free_pixels, data);
+
+	return pixbuf;
+}
+
+static void
+compare_surfaces (cairo_surface_t *a,
+                  cairo_surface_t *b)
+{
+	gint y, width, height;
+
+	g_assert_cmpint (cairo_surface_status (a), ==, CAIRO_STATUS_SUCCESS);
+	g_assert_cmpint (cairo_surface_status (b), ==, CAIRO_STATUS_SUCCESS);
+
+	width = cairo_image_surface_get_width (a);
+	height = cairo_image_surface_get_height (a);
+	g_assert_cmpint (cairo_image_surface_get_width (b), ==, width);
+	g_assert_cmpint (cairo_image_surface_get_height (b), ==, height);
+
+	for (y = 0; y < height; y++) {
+		const guchar *ra = cairo_image_surface_get_data (a) + y * cairo_image_surface_get_stride (a);
+		const guchar *rb = cairo_image_surface_get_data (b) + y * cairo_image_surface_get_stride (b);
+
+		g_assert_cmpmem (ra, width * 4, rb, width * 4);
+	}
+}
+
+static void
+test_scale_matches_scalar (gconstpointer user_data)
+{
+	gboolean has_alpha = GPOINTER_TO_INT (user_data);
+	gint i;
+
+#ifndef __SSE2__
+	g_test_skip ("built without SSE2, both paths are the same");
+	return;
+#endif
+
+	for (i = 0; i < N_ROUNDS; i++) {
+		gint sw = g_test_rand_int_range (1, 300);
+		gint sh = g_test_rand_int_range (1, 300);
+		gint dw = g_test_rand_int_range (1, sw + 1);
+		gint dh = g_test_rand_int_range (1, sh + 1);
+		GdkPixbuf *pixbuf = make_pixbuf (has_alpha, sw, sh);
+		cairo_surface_t *simd, *scalar;
+
+		simd = gooroom_notify_icon_scale_pixbuf (pixbuf, dw, dh);
+		scalar = icon_scale_scalar_pixbuf (pixbuf, dw, dh);
+
+		compare_surfaces (simd, scalar);
+
+		cairo_surface_destroy (simd);
+		cairo_surface_destroy (scalar);
+		g_object_unref (pixbuf);
+	}
+}
+
+/* what the daemon did before the scaler */
+static cairo_surface_t *
+scale_gdk (GdkPixbuf *pixbuf,
+           gint       width,
+           gint       height)
+{
+	GdkPixbuf *scaled;
+	cairo_surface_t *surface;
+
+	scaled = gdk_pixbuf_scale_simple (pixbuf, width, height, GDK_INTERP_BILINEAR);
+	surface = gdk_cairo_surface_create_from_pixbuf (scaled, 1, NULL);
+	g_object_unref (scaled);
+
+	return surface;
+}
+
+static gdouble
+time_scale (cairo_surface_t *(*scale) (GdkPixbuf *, gint, gint),
+            GdkPixbuf        *pixbuf,
+            gint              width,
+            gint              height,
+            gint              rounds)
+{
+	gint i;
+
+	g_test_timer_start ();
+	for (i = 0; i < rounds; i++)
+		cairo_surface_destroy (scale (pixbuf, width, height));
+
+	return g_test_timer_elapsed () * 1e6 / rounds;
+}
+
+/* an image scaled down to an icon, by the SSE2 path, the scalar one and
+ * gdk_pixbuf_scale_simple () with the conversion for cairo */
+static void
+test_scale_perf (gconstpointer user_data)
+{
+	const PerfSize *size = user_data;
+	GdkPixbuf *pixbuf;
+	gdouble simd, scalar, gdk;
+	gint width, height, rounds;
+
+	/* the same number of source pixels for every size */
+	rounds = MAX ((g_test_perf () ? 200000000 : 2000000) / (size->width * size->height), 2);
+
+	pixbuf = make_pixbuf (TRUE, size->width, size->height);
+	gooroom_notify_icon_scale_fit (size->width, size->height, ICON_SIZE, &width, &height);
+
+	simd = time_scale (gooroom_notify_icon_scale_pixbuf, pixbuf, width, height, rounds);
+	scalar = time_scale (icon_scale_scalar_pixbuf, pixbuf, width, height, rounds);
+	gdk = time_scale (scale_gdk, pixbuf, width, height, rounds);
+
+#ifndef __SSE2__
+	g_test_message ("built without SSE2, both paths are the same");
+#endif
+	g_test_message ("%s to %dx%d: SSE2 %.1f us, scalar %.1f us, "
+	                "gdk_pixbuf_scale_simple and cairo %.1f us",
+	                size->name, width, height, simd, scalar, gdk);
+	g_test_minimized_result (simd, "%s: %.1f us", size->name, simd);
+
+	g_object_unref (pixbuf);
+}
+
+int
+main (int argc, char **argv)
+{
+	guint i;
+
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_data_func ("/icon-scale/rgba", GINT_TO_POINTER (TRUE), test_scale_matches_scalar);
+	g_test_add_data_func ("/icon-scale/rgb", GINT_TO_POINTER (FALSE), test_scale_matches_scalar);
+
+	for (i = 0; i < G_N_ELEMENTS (perf_sizes); i++) {
+		gchar *path = g_strdup_printf ("/icon-scale/perf/%s", perf_sizes[i].name);
+
+		g_test_add_data_func (path, &perf_sizes[i], test_scale_perf);
+		g_free (path);
+	}
+
+	return g_test_run ();
+}
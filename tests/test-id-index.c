@@ -0,0 +1,190 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "gooroom-notify-id-index.h"
+
+#define N_LIVE       100000
+
+/* random inserts, lookups and removals, checked against a GHashTable */
+static void
+test_id_index_model (void)
+{
+	GooroomNotifyIdIndex *index = gooroom_notify_id_index_new (NULL);
+	GHashTable *model = g_hash_table_new (NULL, NULL);
+	gint i;
+
+	for (i = 0; i < 200000; i++) {
+		/* a small range so that the same ids come back, with some close
+		 * to the top where subtracting them used to overflow */
+		guint32 id = g_test_rand_int_range (1, 5000);
+		gpointer value = GUINT_TO_POINTER (i + 1);
+
+		if (g_test_rand_bit ())
+			id = G_MAXUINT32 - id;
+
+		switch (g_test_rand_int_range (0, 3)) {
+			case 0:
+				if (!g_hash_table_contains (model, GUINT_TO_POINTER (id))) {
+					gooroom_notify_id_index_insert (index, id, value);
+					g_hash_table_insert (model, GUINT_TO_POINTER (id), value);
+				}
+				break;
+			case 1:
+				g_assert_true (gooroom_notify_id_index_lookup (index, id) ==
+				               g_hash_table_lookup (model, GUINT_TO_POINTER (id)));
+				break;
+			case 2:
+				g_assert_cmpint (gooroom_notify_id_index_remove (index, id), ==,
+				                 g_hash_table_remove (model, GUINT_TO_POINTER (id)));
+				break;
+		}
+
+		g_assert_cmpuint (gooroom_notify_id_index_size (index), ==, g_hash_table_size (model));
+	}
+
+	g_hash_table_unref (model);
+	gooroom_notify_id_index_free (index);
+}
+
+static void
+check_order (guint32  id,
+             gpointer value,
+             gpointer user_data)
+{
+	GooroomNotifyIdIndex *index = ((gpointer *)user_data)[0];
+	guint32 *last = ((gpointer *)user_data)[1];
+
+	g_assert_cmpuint (GPOINTER_TO_UINT (value), ==, id);
+	g_assert_cmpuint (id, >, *last);
+	*last = id;
+
+	/* the entry being visited may go away */
+	if (id % 3 == 0)
+		g_assert_true (gooroom_notify_id_index_remove (index, id));
+}
+
+static void
+test_id_index_foreach (void)
+{
+	GooroomNotifyIdIndex *index = gooroom_notify_id_index_new (NULL);
+	guint32 last = 0;
+	gpointer data[2] = { index, &last };
+	guint32 id;
+
+	for (id = 1; id <= 10000; id++)
+		gooroom_notify_id_index_insert (index, id, GUINT_TO_POINTER (id));
+
+	gooroom_notify_id_index_foreach (index, check_order, data);
+	g_assert_cmpuint (last, ==, 10000);
+	g_assert_cmpuint (gooroom_notify_id_index_size (index), ==, 10000 - 10000 / 3);
+
+	last = 0;
+	gooroom_notify_id_index_foreach (index, check_order, data);
+	g_assert_cmpuint (last, ==, 10000);
+
+	gooroom_notify_id_index_free (index);
+}
+
+static gint
+compare_ids (gconstpointer a,
+             gconstpointer b,
+             gpointer      user_data)
+{
+	guint32 ia = GPOINTER_TO_UINT (a), ib = GPOINTER_TO_UINT (b);
+
+	return ia < ib ? -1 : ia > ib;
+}
+
+/* N_LIVE notifications stay up while the daemon keeps replacing and
+ * closing them, as against the GTree the index replaced */
+static void
+test_id_index_perf (void)
+{
+	GooroomNotifyIdIndex *index = gooroom_notify_id_index_new (NULL);
+	GTree *tree = g_tree_new_full (compare_ids, NULL, NULL, NULL);
+	gint i, n_operations = g_test_perf () ? 1000000 : 20000;
+	guint32 *ids = g_new (guint32, n_operations);
+	guint32 next_id;
+	gdouble index_time, tree_time;
+
+	for (next_id = 1; next_id <= N_LIVE; next_id++) {
+		gooroom_notify_id_index_insert (index, next_id, GUINT_TO_POINTER (next_id));
+		g_tree_insert (tree, GUINT_TO_POINTER (next_id), GUINT_TO_POINTER (next_id));
+	}
+
+	/* the oldest notification is closed and a new one shown every 10th
+	 * step, everything else looks up a live one */
+	for (i = 0; i < n_operations; i++)
+		ids[i] = g_test_rand_int_range (0, N_LIVE);
+
+	g_test_timer_start ();
+	for (i = 0; i < n_operations; i++) {
+		guint32 oldest = next_id - N_LIVE + i / 10;
+
+		if (i % 10 == 0) {
+			gooroom_notify_id_index_remove (index, oldest);
+			gooroom_notify_id_index_insert (index, next_id + i / 10, GUINT_TO_POINTER (1));
+		} else {
+			g_assert_nonnull (gooroom_notify_id_index_lookup (index, oldest + 1 + ids[i] % (N_LIVE - 1)));
+		}
+	}
+	index_time = g_test_timer_elapsed ();
+
+	g_test_timer_start ();
+	for (i = 0; i < n_operations; i++) {
+		guint32 oldest = next_id - N_LIVE + i / 10;
+
+		if (i % 10 == 0) {
+			g_tree_remove (tree, GUINT_TO_POINTER (oldest));
+			g_tree_insert (tree, GUINT_TO_POINTER (next_id + i / 10), GUINT_TO_POINTER (1));
+		} else {
+			g_assert_nonnull (g_tree_lookup (tree, GUINT_TO_POINTER (oldest + 1 + ids[i] % (N_LIVE - 1))));
+		}
+	}
+	tree_time = g_test_timer_elapsed ();
+
+	g_test_message ("%d operations at %d live entries: index %.1f ns, GTree %.1f ns per operation",
+	                n_operations, N_LIVE, index_time * 1e9 / n_operations, tree_time * 1e9 / n_operations);
+	g_test_minimized_result (index_time * 1e9 / n_operations, "%.1f ns per operation",
+	                         index_time * 1e9 / n_operations);
+
+	g_assert_cmpuint (gooroom_notify_id_index_size (index), ==, N_LIVE);
+
+	g_free (ids);
+	g_tree_unref (tree);
+	gooroom_notify_id_index_free (index);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add_func ("/id-index/model", test_id_index_model);
+	g_test_add_func ("/id-index/foreach", test_id_index_foreach);
+	g_test_add_func ("/id-index/perf/live-100k", test_id_index_perf);
+
+	return g_test_run ();
+}
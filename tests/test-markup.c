@@ -0,0 +1,265 @@
+/*
+ *  gooroom-notifyd
+ *
+ *  Copyright (c) 2021 Gooroom <gooroom@gooroom.kr>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include "common.h"
+
+#define N_FUZZ_ROUNDS 2000
+
+static GPtrArray *corpus = NULL;
+
+/* entries are separated by lines holding only %%, the first is a comment */
+static void
+load_corpus (void)
+{
+	gchar *contents, **entries;
+	GError *error = NULL;
+	guint i;
+
+	g_file_get_contents (g_test_get_filename (G_TEST_DIST, "markup-corpus.txt", NULL),
+	                     &contents, NULL, &error);
+	g_assert_no_error (error);
+
+	entries = g_strsplit (contents, "\n%%\n", -1);
+	corpus = g_ptr_array_new_with_free_func (g_free);
+
+	for (i = 1; entries[i]; i++) {
+		gsize len = strlen (entries[i]);
+
+		if (len > 0 && entries[i][len - 1] == '\n')
+			entries[i][len - 1] = '\0';
+		g_ptr_array_add (corpus, g_strdup (entries[i]));
+	}
+
+	g_strfreev (entries);
+	g_free (contents);
+}
+
+static void
+link_markup_start_element (GMarkupParseContext  *context,
+                           const gchar          *element_name,
+                           const gchar         **attribute_names,
+                           const gchar         **attribute_values,
+                           gpointer              user_data,
+                           GError              **error)
+{
+	if (g_strcmp0 (element_name, "a") == 0) {
+		g_assert_cmpstr (attribute_names[0], ==, "href");
+		g_assert_null (attribute_names[1]);
+	} else {
+		g_assert_true (g_strcmp0 (element_name, "b") == 0 ||
+		               g_strcmp0 (element_name, "i") == 0 ||
+		               g_strcmp0 (element_name, "u") == 0 ||
+		               g_strcmp0 (element_name, "markup") == 0);
+		g_assert_null (attribute_names[0]);
+	}
+}
+
+/* Checks the sanitized body the way its consumer parses it: pango without
+ * links, GtkLabel's <a> on top of GMarkup with them. Returns the number of
+ * visible characters. */
+static glong
+check_markup (const gchar *markup,
+              gboolean     keep_links)
+{
+	GError *error = NULL;
+	gchar *text = NULL;
+	glong n_chars;
+
+	if (keep_links) {
+		static const GMarkupParser parser = { link_markup_start_element, NULL, NULL, NULL, NULL };
+		GMarkupParseContext *context;
+		gchar *wrapped;
+
+		wrapped = g_strconcat ("<markup>", markup, "</markup>", NULL);
+		context = g_markup_parse_context_new (&parser, 0, NULL, NULL);
+		g_markup_parse_context_parse (context, wrapped, -1, &error);
+		g_assert_no_error (error);
+		g_markup_parse_context_end_parse (context, &error);
+		g_assert_no_error (error);
+		g_markup_parse_context_free (context);
+		g_free (wrapped);
+
+		/* the links become plain underlines otherwise, the text is the same */
+		markup = wrapped = notify_markup_sanitize (markup, 0, FALSE);
+		pango_parse_markup (markup, -1, 0, NULL, &text, NULL, &error);
+		g_free (wrapped);
+	} else {
+		pango_parse_markup (markup, -1, 0, NULL, &text, NULL, &error);
+	}
+
+	if (error)
+		g_test_message ("invalid markup: %s", markup);
+	g_assert_no_error (error);
+
+	n_chars = g_utf8_strlen (text, -1);
+	g_free (text);
+
+	return n_chars;
+}
+
+static void
+test_markup_corpus (void)
+{
+	guint i;
+
+	for (i = 0; i < corpus->len; i++) {
+		const gchar *body = g_ptr_array_index (corpus, i);
+		gchar *markup;
+
+		markup = notify_markup_sanitize (body, 0, FALSE);
+		check_markup (markup, FALSE);
+		g_free (markup);
+
+		markup = notify_markup_sanitize (body, 0, TRUE);
+		check_markup (markup, TRUE);
+		g_free (markup);
+	}
+}
+
+static void
+test_markup_truncate (void)
+{
+	guint i;
+	gsize max_chars;
+
+	for (i = 0; i < corpus->len; i++) {
+		for (max_chars = 1; max_chars < 40; max_chars += 3) {
+			gchar *markup;
+
+			markup = notify_markup_sanitize (g_ptr_array_index (corpus, i), max_chars, FALSE);
+			g_assert_cmpint (check_markup (markup, FALSE), <=, max_chars);
+			g_free (markup);
+		}
+	}
+}
+
+/* bodies glued together from the pieces that trip up markup parsers */
+static void
+test_markup_fuzz (void)
+{
+	static const gchar *pieces[] = {
+		"<", ">", "/", "&", ";", "#", "x", "\"", "'", "=", " ", "\n", "\001",
+		"<b>", "</b>", "<i>", "</i>", "<u>", "</u>", "<a href=\"", "</a>",
+		"<img alt=\"", "<img/>", "<span>", "&amp;", "&lt;", "&#65;", "&#x",
+		"text", "é", "알림",
+	};
+	gint i, j;
+
+	for (i = 0; i < N_FUZZ_ROUNDS; i++) {
+		GString *body = g_string_new (NULL);
+		gint n = g_test_rand_int_range (1, 40);
+		gchar *markup;
+
+		for (j = 0; j < n; j++)
+			g_string_append (body, pieces[g_test_rand_int_range (0, G_N_ELEMENTS (pieces))]);
+
+		markup = notify_markup_sanitize (body->str, 0, FALSE);
+		check_markup (markup, FALSE);
+		g_free (markup);
+
+		markup = notify_markup_sanitize (body->str, 0, TRUE);
+		check_markup (markup, TRUE);
+		g_free (markup);
+
+		g_string_free (body, TRUE);
+	}
+}
+
+/* Throughput over the corpus; a short run in a plain make check, a longer
+ * one with -m perf. */
+static void
+test_markup_throughput (void)
+{
+	gint i, rounds = g_test_perf () ? 20000 : 200;
+	gsize bytes = 0;
+	gdouble elapsed;
+	guint j;
+
+	g_test_timer_start ();
+
+	for (i = 0; i < rounds; i++) {
+		for (j = 0; j < corpus->len; j++) {
+			const gchar *body = g_ptr_array_index (corpus, j);
+
+			g_free (notify_markup_sanitize (body, 0, TRUE));
+			bytes += strlen (body);
+		}
+	}
+
+	elapsed = g_test_timer_elapsed ();
+
+	g_test_message ("sanitized %" G_GSIZE_FORMAT " bytes in %.3f s, %.1f MB/s",
+	                bytes, elapsed, bytes / elapsed / 1e6);
+	g_test_maximized_result (bytes / elapsed / 1e6, "%.1f MB/s", bytes / elapsed / 1e6);
+}
+
+/* a single large, badly formed body, which must not take longer per byte */
+static void
+test_markup_large_body (void)
+{
+	GString *body = g_string_new (NULL);
+	gchar *markup;
+	gdouble elapsed;
+
+	while (body->len < 4 * 1024 * 1024)
+		g_string_append (body, "<b>bold <i>both</b> & more <a href='x'>< link</a> &#x41; <img alt=\"pic\">\n");
+
+	g_test_timer_start ();
+	markup = notify_markup_sanitize (body->str, 0, TRUE);
+	elapsed = g_test_timer_elapsed ();
+
+	check_markup (markup, TRUE);
+
+	g_test_message ("sanitized a %" G_GSIZE_FORMAT " byte body in %.3f s, %.1f MB/s",
+	                body->len, elapsed, body->len / elapsed / 1e6);
+	g_test_maximized_result (body->len / elapsed / 1e6, "%.1f MB/s", body->len / elapsed / 1e6);
+
+	g_free (markup);
+	g_string_free (body, TRUE);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint ret;
+
+	g_test_init (&argc, &argv, NULL);
+
+	load_corpus ();
+
+	g_test_add_func ("/markup/corpus", test_markup_corpus);
+	g_test_add_func ("/markup/truncate", test_markup_truncate);
+	g_test_add_func ("/markup/fuzz", test_markup_fuzz);
+	g_test_add_func ("/markup/perf/throughput", test_markup_throughput);
+	g_test_add_func ("/markup/perf/large-body", test_markup_large_body);
+
+	ret = g_test_run ();
+
+	g_ptr_array_unref (corpus);
+
+	return ret;
+}